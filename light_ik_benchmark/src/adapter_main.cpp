@@ -0,0 +1,162 @@
+#include "benchmark_rig.h"
+#include "synthetic_skeleton.h"
+#include "conversions.h"
+
+#include "light_ik/light_ik.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace LightIKBenchmark;
+
+namespace
+{
+
+// The adapter of the plugin: targets converted from Godot types to the solver every frame and
+// the compact list of solved rotations converted back. The solve itself is measured by light_ik_benchmark
+struct AdapterParameters
+{
+    size_t      frames          = 1000;
+    size_t      iterations      = 4;
+    std::string outputPath;
+};
+
+struct AdapterResult
+{
+    std::string name;
+    size_t      bones               = 0;
+    size_t      chains              = 0;
+    double      targetsNsPerFrame   = 0;
+    double      solutionNsPerFrame  = 0;
+};
+
+AdapterResult RunCase(const SyntheticSkeleton& skeleton, const AdapterParameters& parameters)
+{
+    AdapterResult result;
+    result.name     = skeleton.GetName();
+    result.bones    = skeleton.GetBoneCount();
+    result.chains   = skeleton.GetChains().size();
+
+    BenchmarkRig rig = BuildRig(skeleton, false);
+    std::vector<godot::Vector3> targets(rig.targets.size());
+    std::vector<godot::Quaternion> solution;
+    solution.reserve(skeleton.GetBoneCount());
+
+    double targetsTime = 0;
+    double solutionTime = 0;
+    for (size_t frame = 0; frame < parameters.frames; ++frame)
+    {
+        // positions of targets come from Godot nodes in the plugin
+        for (size_t chain = 0; chain < targets.size(); ++chain)
+        {
+            Vector3 position = GetTargetPosition(rig, chain, frame);
+            targets[chain] = godot::Vector3((godot::real_t)position.x, (godot::real_t)position.y, (godot::real_t)position.z);
+        }
+
+        auto targetsStart = Clock::now();
+        for (size_t chain = 0; chain < targets.size(); ++chain)
+        {
+            rig.targets[chain]->SetPosition(godot::ToLightIKVector(targets[chain]));
+        }
+        auto targetsEnd = Clock::now();
+
+        rig.controller->Update(parameters.iterations);
+
+        // write-back path of the plugin: compact list of rotations converted to Godot types
+        auto solutionStart = Clock::now();
+        solution.clear();
+        for (const auto& delta : rig.controller->GetDeltaRotations())
+        {
+            if (delta)
+            {
+                solution.emplace_back(godot::FromLightIKQuaternion(*delta));
+            }
+        }
+        auto solutionEnd = Clock::now();
+
+        targetsTime += std::chrono::duration<double, std::nano>(targetsEnd - targetsStart).count();
+        solutionTime += std::chrono::duration<double, std::nano>(solutionEnd - solutionStart).count();
+    }
+    result.targetsNsPerFrame    = targetsTime / parameters.frames;
+    result.solutionNsPerFrame   = solutionTime / parameters.frames;
+    return result;
+}
+
+void WriteResults(FILE* output, const std::vector<AdapterResult>& results)
+{
+    // conversions don't change precision when the solver and Godot use the same scalar type
+    std::fprintf(output, "{\n  \"solver_real_bytes\": %zu,\n  \"godot_real_bytes\": %zu,\n  \"adapters\": [\n",
+        sizeof(LightIK::real), sizeof(godot::real_t));
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const AdapterResult& result = results[i];
+        std::fprintf(output, 
+            "    {\"name\": \"%s\", \"bones\": %zu, \"chains\": %zu, \"targets_ns_per_frame\": %.1f, \"solution_ns_per_frame\": %.1f}%s\n",
+            result.name.c_str(), result.bones, result.chains, result.targetsNsPerFrame, result.solutionNsPerFrame,
+            (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(output, "  ]\n}\n");
+}
+
+bool ParseParameters(int argc, char** argv, AdapterParameters& parameters)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            parameters.frames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+        {
+            parameters.outputPath = argv[++i];
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: light_ik_adapter_benchmark [--frames N] [--output file.json]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    AdapterParameters parameters;
+    if (!ParseParameters(argc, argv, parameters))
+    {
+        return 1;
+    }
+
+    const std::vector<SyntheticSkeleton> skeletons = {
+        SyntheticSkeleton::MakeLimb(),
+        SyntheticSkeleton::MakeHumanoid(),
+        SyntheticSkeleton::MakeTentacle(64),
+        SyntheticSkeleton::MakeTentacle(256),
+        SyntheticSkeleton::MakeTree(3, 4),
+    };
+
+    std::vector<AdapterResult> results;
+    for (const SyntheticSkeleton& skeleton : skeletons)
+    {
+        results.emplace_back(RunCase(skeleton, parameters));
+    }
+
+    FILE* output = parameters.outputPath.empty() ? stdout : std::fopen(parameters.outputPath.c_str(), "w");
+    if (!output)
+    {
+        std::fprintf(stderr, "cannot open %s\n", parameters.outputPath.c_str());
+        return 1;
+    }
+    WriteResults(output, results);
+    if (output != stdout)
+    {
+        std::fclose(output);
+    }
+    return 0;
+}
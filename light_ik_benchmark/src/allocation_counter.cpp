@@ -0,0 +1,42 @@
+#include "allocation_counter.h"
+
+#ifdef LIGHT_IK_BENCHMARK_COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// all heap allocations of the process are counted, the benchmark reads the counter around the measured code
+static std::atomic<uint64_t> g_allocationsCount{0};
+
+void* operator new(std::size_t size)
+{
+    g_allocationsCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace LightIKBenchmark
+{
+
+uint64_t GetAllocationsCount()
+{
+    return g_allocationsCount.load(std::memory_order_relaxed);
+}
+
+}
+
+#endif
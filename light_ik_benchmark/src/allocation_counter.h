@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+namespace LightIKBenchmark
+{
+
+// Heap allocations of the process are counted only in builds with LIGHT_IK_BENCHMARK_COUNT_ALLOCATIONS.
+// The counter replaces global operator new, so timings of such builds are not comparable with the regular ones
+#ifdef LIGHT_IK_BENCHMARK_COUNT_ALLOCATIONS
+constexpr bool AllocationsCounted = true;
+uint64_t GetAllocationsCount();
+#else
+constexpr bool AllocationsCounted = false;
+static inline uint64_t GetAllocationsCount() { return 0; }
+#endif
+
+}
@@ -0,0 +1,77 @@
+#include "benchmark_rig.h"
+
+#include <algorithm>
+
+namespace LightIKBenchmark
+{
+
+BenchmarkRig BuildRig(const SyntheticSkeleton& skeleton, bool constrained, int mode)
+{
+    BenchmarkRig rig;
+    rig.controller = std::make_unique<LightIK::LightIK>(skeleton.GetBoneCount());
+    for (const SyntheticChain& chain : skeleton.GetChains())
+    {
+        LightIK::TargetPosition& target = rig.controller->CreateTarget();
+        rig.controller->CreateIKChain(skeleton.BuildRootChain(chain.tipBone), chain.startBone, 0, target);
+        rig.targets.emplace_back(&target);
+        rig.solvers.emplace_back(rig.controller->GetSolversCount() - 1);
+
+        // targets orbit around the point between the start and the rest position of the tip, so they stay reachable
+        Vector3 start = skeleton.GetBonePosition(chain.startBone);
+        Vector3 tip   = skeleton.GetTipPosition(chain.tipBone);
+        rig.centers.emplace_back(start.lerp(tip, 0.7));
+        rig.radiuses.emplace_back(0.2 * skeleton.GetChainLength(chain));
+
+        if (constrained)
+        {
+            // limits on every bone modified by the chain
+            for (int32_t bone : skeleton.GetChainBones(chain))
+            {
+                rig.controller->SetConstraint(bone, LightIK::Constraints {
+                    (LightIK::ConstraintModes)mode,
+                    (LightIK::ConstraintRotation)1,
+                    1.0,
+                    ToLightIKVector(Vector3{-1, -1, -1}),
+                    ToLightIKVector(Vector3{1, 1, 1}),
+                });
+            }
+        }
+    }
+    return rig;
+}
+
+Vector3 GetTargetPosition(const BenchmarkRig& rig, size_t chain, size_t frame)
+{
+    double phase = 0.05 * frame + chain;
+    return rig.centers[chain] + Vector3{std::cos(phase), 0.5 * std::sin(2 * phase), std::sin(phase)} * rig.radiuses[chain];
+}
+
+void SetTargets(BenchmarkRig& rig, size_t frame)
+{
+    for (size_t chain = 0; chain < rig.targets.size(); ++chain)
+    {
+        rig.targets[chain]->SetPosition(ToLightIKVector(GetTargetPosition(rig, chain, frame)));
+    }
+}
+
+bool IsConverged(const BenchmarkRig& rig)
+{
+    for (size_t solver : rig.solvers)
+    {
+        Vector3 offset = FromLightIKVector(rig.controller->GetTipPosition(solver)) - FromLightIKVector(rig.controller->GetTargetPosition(solver));
+        if (offset.length() > ConvergenceTolerance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+double GetPercentile(std::vector<double> values, double percentile)
+{
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t)(percentile * values.size()));
+    return values[index];
+}
+
+}
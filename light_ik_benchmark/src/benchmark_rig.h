@@ -0,0 +1,44 @@
+#pragma once
+
+#include "synthetic_skeleton.h"
+
+#include "light_ik/light_ik.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+namespace LightIKBenchmark
+{
+
+using Clock = std::chrono::steady_clock;
+
+// distance from the tip to the target when the chain is considered converged
+constexpr double ConvergenceTolerance = 1e-3;
+
+// values of JointConstraints::rotation_order
+enum ConstraintMode
+{
+    ConstraintPassThrough   = 0,
+    ConstraintTwistSwing    = 1,
+    ConstraintEulerXYZ      = 6,
+};
+
+// Controller with all chains of the synthetic skeleton, built the same way the plugin builds it
+struct BenchmarkRig
+{
+    std::unique_ptr<LightIK::LightIK>       controller;
+    std::vector<LightIK::TargetPosition*>   targets;
+    std::vector<size_t>                     solvers;
+    std::vector<Vector3>                    centers;
+    std::vector<double>                     radiuses;
+};
+
+BenchmarkRig BuildRig(const SyntheticSkeleton& skeleton, bool constrained, int mode = ConstraintTwistSwing);
+// frame coherent movement of the target, like the animated marker
+Vector3 GetTargetPosition(const BenchmarkRig& rig, size_t chain, size_t frame);
+void SetTargets(BenchmarkRig& rig, size_t frame);
+bool IsConverged(const BenchmarkRig& rig);
+double GetPercentile(std::vector<double> values, double percentile);
+
+}
@@ -0,0 +1,319 @@
+#include "allocation_counter.h"
+#include "benchmark_rig.h"
+#include "synthetic_skeleton.h"
+
+#include "light_ik/light_ik.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace LightIKBenchmark;
+
+namespace
+{
+
+struct BenchmarkParameters
+{
+    size_t      frames          = 1000;
+    size_t      warmupFrames    = 50;
+    std::string outputPath;
+};
+
+struct BenchmarkCase
+{
+    const SyntheticSkeleton*    skeleton    = nullptr;
+    bool                        constrained = false;
+    size_t                      iterations  = 1;
+    int                         mode        = ConstraintTwistSwing;
+};
+
+struct BenchmarkResult
+{
+    std::string name;
+    size_t      bones               = 0;
+    size_t      chains              = 0;
+    bool        constrained         = false;
+    size_t      iterations          = 0;
+    double      nsPerSolve          = 0;
+    double      nsPerSolveP50       = 0;
+    double      nsPerSolveP99       = 0;
+    double      iterationsToConverge= 0;
+    double      allocationsPerFrame = 0;
+    double      chainsPerSecond     = 0;
+};
+
+// Many characters of the same type, every instance has its own controller as in the plugin
+struct CrowdResult
+{
+    std::string name;
+    size_t      instances           = 0;
+    size_t      chains              = 0;
+    size_t      iterations          = 0;
+    double      nsPerFrame          = 0;
+    double      chainsPerSecond     = 0;
+};
+
+// Chain of the fixed length with the same constraint mode on every bone. The baseline cost of the solve by the constraint mode
+// and the chain length, modes differ by the constraint work, so their times are not compared with each other
+struct ConstraintModeResult
+{
+    std::string mode;
+    size_t      chainLength         = 0;
+    size_t      iterations          = 0;
+    double      nsPerSolve          = 0;
+};
+
+BenchmarkResult RunCase(const BenchmarkCase& benchmarkCase, const BenchmarkParameters& parameters)
+{
+    const SyntheticSkeleton& skeleton = *benchmarkCase.skeleton;
+
+    BenchmarkResult result;
+    result.name         = skeleton.GetName();
+    result.bones        = skeleton.GetBoneCount();
+    result.chains       = skeleton.GetChains().size();
+    result.constrained  = benchmarkCase.constrained;
+    result.iterations   = benchmarkCase.iterations;
+
+    // Fixed iterations count, as the plugin does by default
+    BenchmarkRig rig = BuildRig(skeleton, benchmarkCase.constrained, benchmarkCase.mode);
+    for (size_t frame = 0; frame < parameters.warmupFrames; ++frame)
+    {
+        SetTargets(rig, frame);
+        rig.controller->Update(benchmarkCase.iterations);
+    }
+
+    std::vector<double> solveTimes;
+    solveTimes.reserve(parameters.frames);
+    uint64_t allocations = 0;
+    for (size_t frame = 0; frame < parameters.frames; ++frame)
+    {
+        SetTargets(rig, parameters.warmupFrames + frame);
+
+        auto solveStart = Clock::now();
+        uint64_t allocationsBefore = GetAllocationsCount();
+        rig.controller->Update(benchmarkCase.iterations);
+        allocations += GetAllocationsCount() - allocationsBefore;
+        auto solveEnd = Clock::now();
+
+        solveTimes.emplace_back(std::chrono::duration<double, std::nano>(solveEnd - solveStart).count());
+    }
+
+    double totalTime = 0;
+    for (double time : solveTimes)
+    {
+        totalTime += time;
+    }
+    result.nsPerSolve           = totalTime / parameters.frames;
+    result.nsPerSolveP50        = GetPercentile(solveTimes, 0.5);
+    result.nsPerSolveP99        = GetPercentile(solveTimes, 0.99);
+    result.allocationsPerFrame  = (double)allocations / parameters.frames;
+    result.chainsPerSecond      = result.chains * 1e9 / result.nsPerSolve;
+
+    // Iterations required to converge, iterations count of the case is the upper limit
+    BenchmarkRig adaptiveRig = BuildRig(skeleton, benchmarkCase.constrained, benchmarkCase.mode);
+    size_t iterationsUsed = 0;
+    for (size_t frame = 0; frame < parameters.frames; ++frame)
+    {
+        SetTargets(adaptiveRig, parameters.warmupFrames + frame);
+        for (size_t iteration = 0; iteration < benchmarkCase.iterations; ++iteration)
+        {
+            adaptiveRig.controller->Update(1);
+            ++iterationsUsed;
+            if (IsConverged(adaptiveRig))
+            {
+                break;
+            }
+        }
+    }
+    result.iterationsToConverge = (double)iterationsUsed / parameters.frames;
+
+    return result;
+}
+
+CrowdResult RunCrowdCase(const SyntheticSkeleton& skeleton, size_t instances, size_t iterations, const BenchmarkParameters& parameters)
+{
+    CrowdResult result;
+    result.name         = skeleton.GetName();
+    result.instances    = instances;
+    result.chains       = instances * skeleton.GetChains().size();
+    result.iterations   = iterations;
+
+    // chains of all instances have the same topology, this is the scalar reference for batched solving
+    std::vector<BenchmarkRig> rigs;
+    for (size_t instance = 0; instance < instances; ++instance)
+    {
+        rigs.emplace_back(BuildRig(skeleton, false));
+    }
+
+    double totalTime = 0;
+    for (size_t frame = 0; frame < parameters.warmupFrames + parameters.frames; ++frame)
+    {
+        for (size_t instance = 0; instance < instances; ++instance)
+        {
+            // instances are out of phase, so every one of them gets its own targets
+            SetTargets(rigs[instance], frame + instance);
+        }
+
+        auto solveStart = Clock::now();
+        for (BenchmarkRig& rig : rigs)
+        {
+            rig.controller->Update(iterations);
+        }
+        if (frame >= parameters.warmupFrames)
+        {
+            totalTime += std::chrono::duration<double, std::nano>(Clock::now() - solveStart).count();
+        }
+    }
+    result.nsPerFrame       = totalTime / parameters.frames;
+    result.chainsPerSecond  = result.chains * 1e9 / result.nsPerFrame;
+    return result;
+}
+
+std::vector<ConstraintModeResult> RunConstraintModeCases(size_t iterations, const BenchmarkParameters& parameters)
+{
+    const std::pair<const char*, int> modes[] = {
+        {"unconstrained",   ConstraintPassThrough},
+        {"twist_swing",     ConstraintTwistSwing},
+        {"euler_xyz",       ConstraintEulerXYZ},
+    };
+
+    std::vector<ConstraintModeResult> results;
+    for (size_t chainLength = 2; chainLength <= 8; ++chainLength)
+    {
+        // the tentacle has the root bone and the chain of the requested length
+        SyntheticSkeleton skeleton = SyntheticSkeleton::MakeTentacle(chainLength + 1);
+        for (const auto& [name, mode] : modes)
+        {
+            BenchmarkResult result = RunCase(BenchmarkCase{&skeleton, mode != ConstraintPassThrough, iterations, mode}, parameters);
+            results.emplace_back(ConstraintModeResult{name, chainLength, iterations, result.nsPerSolve});
+        }
+    }
+    return results;
+}
+
+void WriteResults(FILE* output, const std::vector<BenchmarkResult>& results, const std::vector<CrowdResult>& crowds,
+                  const std::vector<ConstraintModeResult>& constraintModes)
+{
+    // precision of the solver build, results of float and double builds are not directly comparable.
+    // Allocations are reported only by the counting build, its timings are affected by the counter
+    std::fprintf(output, "{\n  \"solver_real_bytes\": %zu,\n  \"allocations_counted\": %s,\n  \"benchmarks\": [\n",
+        sizeof(LightIK::real), AllocationsCounted ? "true" : "false");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchmarkResult& result = results[i];
+        char allocations[32] = "null";
+        if (AllocationsCounted)
+        {
+            std::snprintf(allocations, sizeof(allocations), "%.2f", result.allocationsPerFrame);
+        }
+        std::fprintf(output, 
+            "    {\"name\": \"%s\", \"bones\": %zu, \"chains\": %zu, \"constrained\": %s, \"iterations\": %zu, "
+            "\"ns_per_solve\": %.1f, \"ns_per_solve_p50\": %.1f, \"ns_per_solve_p99\": %.1f, "
+            "\"iterations_to_converge\": %.2f, \"allocations_per_frame\": %s, \"chains_per_second\": %.0f}%s\n",
+            result.name.c_str(), result.bones, result.chains, result.constrained ? "true" : "false", result.iterations,
+            result.nsPerSolve, result.nsPerSolveP50, result.nsPerSolveP99,
+            result.iterationsToConverge, allocations, result.chainsPerSecond,
+            (i + 1 < results.size()) ? "," : "");
+    }
+    std::fprintf(output, "  ],\n  \"crowds\": [\n");
+    for (size_t i = 0; i < crowds.size(); ++i)
+    {
+        const CrowdResult& crowd = crowds[i];
+        std::fprintf(output, 
+            "    {\"name\": \"%s\", \"instances\": %zu, \"chains\": %zu, \"iterations\": %zu, "
+            "\"ns_per_frame\": %.1f, \"chains_per_second\": %.0f}%s\n",
+            crowd.name.c_str(), crowd.instances, crowd.chains, crowd.iterations,
+            crowd.nsPerFrame, crowd.chainsPerSecond,
+            (i + 1 < crowds.size()) ? "," : "");
+    }
+    std::fprintf(output, "  ],\n  \"constraint_modes\": [\n");
+    for (size_t i = 0; i < constraintModes.size(); ++i)
+    {
+        const ConstraintModeResult& constraintMode = constraintModes[i];
+        std::fprintf(output, 
+            "    {\"mode\": \"%s\", \"chain_length\": %zu, \"iterations\": %zu, \"ns_per_solve\": %.1f}%s\n",
+            constraintMode.mode.c_str(), constraintMode.chainLength, constraintMode.iterations, constraintMode.nsPerSolve,
+            (i + 1 < constraintModes.size()) ? "," : "");
+    }
+    std::fprintf(output, "  ]\n}\n");
+}
+
+bool ParseParameters(int argc, char** argv, BenchmarkParameters& parameters)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+        {
+            parameters.frames = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+        {
+            parameters.outputPath = argv[++i];
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: light_ik_benchmark [--frames N] [--output file.json]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    BenchmarkParameters parameters;
+    if (!ParseParameters(argc, argv, parameters))
+    {
+        return 1;
+    }
+
+    const std::vector<SyntheticSkeleton> skeletons = {
+        SyntheticSkeleton::MakeLimb(),
+        SyntheticSkeleton::MakeHumanoid(),
+        SyntheticSkeleton::MakeTentacle(64),
+        SyntheticSkeleton::MakeTentacle(256),
+        SyntheticSkeleton::MakeTree(3, 4),
+    };
+
+    std::vector<BenchmarkResult> results;
+    for (const SyntheticSkeleton& skeleton : skeletons)
+    {
+        for (bool constrained : {false, true})
+        {
+            for (size_t iterations : {1, 2, 4, 8, 16, 32})
+            {
+                results.emplace_back(RunCase(BenchmarkCase{&skeleton, constrained, iterations}, parameters));
+            }
+        }
+    }
+
+    std::vector<CrowdResult> crowds;
+    for (size_t instances : {16, 256})
+    {
+        for (size_t iterations : {1, 4})
+        {
+            crowds.emplace_back(RunCrowdCase(skeletons[1], instances, iterations, parameters));
+        }
+    }
+
+    std::vector<ConstraintModeResult> constraintModes = RunConstraintModeCases(4, parameters);
+
+    FILE* output = parameters.outputPath.empty() ? stdout : std::fopen(parameters.outputPath.c_str(), "w");
+    if (!output)
+    {
+        std::fprintf(stderr, "cannot open %s\n", parameters.outputPath.c_str());
+        return 1;
+    }
+    WriteResults(output, results, crowds, constraintModes);
+    if (output != stdout)
+    {
+        std::fclose(output);
+    }
+    return 0;
+}
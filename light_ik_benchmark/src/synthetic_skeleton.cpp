@@ -0,0 +1,178 @@
+#include "synthetic_skeleton.h"
+
+#include <algorithm>
+#include <numbers>
+
+namespace LightIKBenchmark
+{
+
+constexpr double Pi = std::numbers::pi;
+// every bone is bent relatively to its parent to avoid degenerate configurations of the chains
+constexpr double BoneBendAngle = Pi / 18.0;
+
+Quaternion Quaternion::FromAxisAngle(const Vector3& axis, double angle)
+{
+    Vector3 unit = axis * (1.0 / axis.length());
+    double s = std::sin(angle * 0.5);
+    return Quaternion{std::cos(angle * 0.5), unit.x * s, unit.y * s, unit.z * s};
+}
+
+Quaternion Quaternion::operator*(const Quaternion& other) const
+{
+    return Quaternion{
+        w * other.w - x * other.x - y * other.y - z * other.z,
+        w * other.x + x * other.w + y * other.z - z * other.y,
+        w * other.y - x * other.z + y * other.w + z * other.x,
+        w * other.z + x * other.y - y * other.x + z * other.w,
+    };
+}
+
+Vector3 Quaternion::xform(const Vector3& vector) const
+{
+    Quaternion rotated = *this * Quaternion{0, vector.x, vector.y, vector.z} * Quaternion{w, -x, -y, -z};
+    return Vector3{rotated.x, rotated.y, rotated.z};
+}
+
+SyntheticSkeleton SyntheticSkeleton::MakeLimb()
+{
+    // root bone and two bones of the limb, like the hip-femur-shin of a leg
+    SyntheticSkeleton skeleton("limb_2");
+    int32_t root = skeleton.AddBone(-1, Quaternion{}, 1);
+    int32_t tip  = skeleton.AddBranch(root, 2, Vector3{1, 0, 0}, 1);
+    skeleton.AddChain(root + 1, tip);
+    return skeleton;
+}
+
+SyntheticSkeleton SyntheticSkeleton::MakeHumanoid()
+{
+    // 5 chains rig: legs and arms, and the head chain that shares the spine with the arms
+    SyntheticSkeleton skeleton("humanoid_5");
+    int32_t hips    = skeleton.AddBone(-1, Quaternion{}, 0.2f);
+    int32_t chest   = skeleton.AddBranch(hips, 2, Vector3{1, 0, 0}, 0.3f);
+    int32_t head    = skeleton.AddBranch(chest, 2, Vector3{1, 0, 0}, 0.15f);
+    skeleton.AddChain(hips + 1, head);
+
+    for (double side : {1.0, -1.0})
+    {
+        int32_t shoulder    = skeleton.AddBone(chest, Quaternion::FromAxisAngle(Vector3{0, 0, 1}, side * Pi / 2), 0.2f);
+        int32_t hand        = skeleton.AddBranch(shoulder, 3, Vector3{1, 0, 0}, 0.3f);
+        skeleton.AddChain(shoulder + 1, hand);
+
+        int32_t hip         = skeleton.AddBone(hips, Quaternion::FromAxisAngle(Vector3{0, 0, 1}, side * Pi * 0.9), 0.15f);
+        int32_t foot        = skeleton.AddBranch(hip, 4, Vector3{1, 0, 0}, 0.45f);
+        skeleton.AddChain(hip, foot);
+    }
+    return skeleton;
+}
+
+SyntheticSkeleton SyntheticSkeleton::MakeTentacle(size_t bonesCount)
+{
+    SyntheticSkeleton skeleton("tentacle_" + std::to_string(bonesCount));
+    int32_t root    = skeleton.AddBone(-1, Quaternion{}, 0.1f);
+    int32_t tip     = skeleton.AddBranch(root, bonesCount - 1, Vector3{1, 0, 0}, 4.f / bonesCount);
+    skeleton.AddChain(root + 1, tip);
+    return skeleton;
+}
+
+SyntheticSkeleton SyntheticSkeleton::MakeTree(size_t depth, size_t branchLength)
+{
+    // binary tree of branches, every leaf branch is solved by its own chain
+    SyntheticSkeleton skeleton("tree_" + std::to_string(depth) + "x" + std::to_string(branchLength));
+    std::vector<int32_t> level = {skeleton.AddBone(-1, Quaternion{}, 0.1f)};
+    for (size_t d = 0; d < depth; ++d)
+    {
+        std::vector<int32_t> nextLevel;
+        for (int32_t parent : level)
+        {
+            for (double side : {1.0, -1.0})
+            {
+                int32_t first   = skeleton.AddBone(parent, Quaternion::FromAxisAngle(Vector3{0, 0, 1}, side * Pi / 4), 0.3f);
+                int32_t last    = skeleton.AddBranch(first, branchLength - 1, Vector3{1, 0, 0}, 0.3f);
+                if (d + 1 == depth)
+                {
+                    skeleton.AddChain(first, last);
+                }
+                nextLevel.emplace_back(last);
+            }
+        }
+        level = std::move(nextLevel);
+    }
+    return skeleton;
+}
+
+int32_t SyntheticSkeleton::AddBone(int32_t parent, const Quaternion& rotation, double length)
+{
+    m_parents.emplace_back(parent);
+    m_rotations.emplace_back(rotation);
+    m_lengths.emplace_back(length);
+    return (int32_t)m_parents.size() - 1;
+}
+
+int32_t SyntheticSkeleton::AddBranch(int32_t parent, size_t bonesCount, const Vector3& bendAxis, double length)
+{
+    for (size_t i = 0; i < bonesCount; ++i)
+    {
+        parent = AddBone(parent, Quaternion::FromAxisAngle(bendAxis, BoneBendAngle), length);
+    }
+    return parent;
+}
+
+std::vector<LightIK::BoneDesc> SyntheticSkeleton::BuildRootChain(int32_t tipBone) const
+{
+    std::vector<LightIK::BoneDesc> rootChain;
+    for (int32_t bone = tipBone; bone >= 0; bone = m_parents[bone])
+    {
+        rootChain.emplace_back(LightIK::BoneDesc{ToLightIKQuaternion(m_rotations[bone]), (LightIK::real)m_lengths[bone], bone});
+    }
+    std::reverse(rootChain.begin(), rootChain.end());
+    return rootChain;
+}
+
+std::vector<int32_t> SyntheticSkeleton::GetChainBones(const SyntheticChain& chain) const
+{
+    std::vector<int32_t> bones;
+    for (int32_t bone = chain.tipBone; bone >= 0; bone = m_parents[bone])
+    {
+        bones.emplace_back(bone);
+        if (bone == chain.startBone)
+        {
+            break;
+        }
+    }
+    std::reverse(bones.begin(), bones.end());
+    return bones;
+}
+
+Quaternion SyntheticSkeleton::GetGlobalRotation(int32_t bone) const
+{
+    Quaternion rotation;
+    for (; bone >= 0; bone = m_parents[bone])
+    {
+        rotation = m_rotations[bone] * rotation;
+    }
+    return rotation;
+}
+
+Vector3 SyntheticSkeleton::GetBonePosition(int32_t bone) const
+{
+    // bone starts at the end of its parent
+    int32_t parent = m_parents[bone];
+    return parent >= 0 ? GetTipPosition(parent) : Vector3{};
+}
+
+Vector3 SyntheticSkeleton::GetTipPosition(int32_t bone) const
+{
+    return GetBonePosition(bone) + GetGlobalRotation(bone).xform(Vector3{0, m_lengths[bone], 0});
+}
+
+double SyntheticSkeleton::GetChainLength(const SyntheticChain& chain) const
+{
+    double length = 0;
+    for (int32_t bone : GetChainBones(chain))
+    {
+        length += m_lengths[bone];
+    }
+    return length;
+}
+
+}
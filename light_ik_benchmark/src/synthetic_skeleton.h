@@ -0,0 +1,100 @@
+#pragma once
+
+#include "light_ik/light_ik.h"
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace LightIKBenchmark
+{
+
+// The benchmark of the solver doesn't depend on the engine, so the skeleton is generated with its own minimal math
+struct Vector3
+{
+    double x = 0;
+    double y = 0;
+    double z = 0;
+
+    Vector3 operator+(const Vector3& other) const   { return Vector3{x + other.x, y + other.y, z + other.z}; }
+    Vector3 operator-(const Vector3& other) const   { return Vector3{x - other.x, y - other.y, z - other.z}; }
+    Vector3 operator*(double scale) const           { return Vector3{x * scale, y * scale, z * scale}; }
+    Vector3 lerp(const Vector3& to, double weight) const { return *this + (to - *this) * weight; }
+    double length() const                           { return std::sqrt(x * x + y * y + z * z); }
+};
+
+struct Quaternion
+{
+    double w = 1;
+    double x = 0;
+    double y = 0;
+    double z = 0;
+
+    static Quaternion FromAxisAngle(const Vector3& axis, double angle);
+    Quaternion operator*(const Quaternion& other) const;
+    Vector3 xform(const Vector3& vector) const;
+};
+
+static inline LightIK::Vector ToLightIKVector(const Vector3& src)
+{
+    return LightIK::Vector{(LightIK::real)src.x, (LightIK::real)src.y, (LightIK::real)src.z};
+}
+
+static inline LightIK::Quaternion ToLightIKQuaternion(const Quaternion& src)
+{
+    return LightIK::Quaternion{(LightIK::real)src.w, (LightIK::real)src.x, (LightIK::real)src.y, (LightIK::real)src.z};
+}
+
+static inline Vector3 FromLightIKVector(const LightIK::Vector& src)
+{
+    return Vector3{(double)src.x, (double)src.y, (double)src.z};
+}
+
+struct SyntheticChain
+{
+    int32_t startBone   = -1;
+    int32_t tipBone     = -1;
+};
+
+/// @brief Bone hierarchy generated for benchmarks. Bones are directed along Y axis like the bones of Godot skeletons,
+/// every bone is slightly bent relatively to its parent to avoid degenerate straight chains
+class SyntheticSkeleton
+{
+public:
+    explicit SyntheticSkeleton(std::string name) : m_name(std::move(name)) {}
+
+    // Standard set of skeletons used by the benchmark
+    static SyntheticSkeleton MakeLimb();
+    static SyntheticSkeleton MakeHumanoid();
+    static SyntheticSkeleton MakeTentacle(size_t bonesCount);
+    static SyntheticSkeleton MakeTree(size_t depth, size_t branchLength);
+
+    int32_t AddBone(int32_t parent, const Quaternion& rotation, double length);
+    // adds the sequence of bones and returns the last bone of the branch
+    int32_t AddBranch(int32_t parent, size_t bonesCount, const Vector3& bendAxis, double length);
+    void AddChain(int32_t startBone, int32_t tipBone)               { m_chains.emplace_back(SyntheticChain{startBone, tipBone}); }
+
+    const std::string& GetName() const                              { return m_name;            }
+    size_t GetBoneCount() const                                     { return m_parents.size();  }
+    const std::vector<SyntheticChain>& GetChains() const            { return m_chains;          }
+
+    // the same chain the plugin builds: all bones from the skeleton root to the tip
+    std::vector<LightIK::BoneDesc> BuildRootChain(int32_t tipBone) const;
+    // bones modified by the chain, from the start bone to the tip
+    std::vector<int32_t> GetChainBones(const SyntheticChain& chain) const;
+
+    Vector3 GetBonePosition(int32_t bone) const;
+    Vector3 GetTipPosition(int32_t bone) const;
+    double GetChainLength(const SyntheticChain& chain) const;
+
+private:
+    Quaternion GetGlobalRotation(int32_t bone) const;
+
+    std::string                     m_name;
+    std::vector<int32_t>            m_parents;
+    std::vector<Quaternion>         m_rotations;
+    std::vector<double>             m_lengths;
+    std::vector<SyntheticChain>     m_chains;
+};
+
+}
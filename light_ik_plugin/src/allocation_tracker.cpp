@@ -0,0 +1,58 @@
+#include "allocation_tracker.h"
+
+#ifdef LIGHT_IK_TRACK_ALLOCATIONS
+#include <cstdlib>
+#include <new>
+
+// each thread counts its own allocations, so the solver threads don't contend on the counter
+static thread_local uint64_t t_allocationsCount = 0;
+
+void* operator new(std::size_t size)
+{
+    ++t_allocationsCount;
+    if (void* memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+#endif
+
+namespace godot
+{
+
+uint64_t GetThreadAllocationsCount()
+{
+#ifdef LIGHT_IK_TRACK_ALLOCATIONS
+    return t_allocationsCount;
+#else
+    return 0;
+#endif
+}
+
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+namespace godot
+{
+
+// Number of heap allocations made by the calling thread. Allocations are counted only if the plugin is built
+// with LIGHT_IK_TRACK_ALLOCATIONS, otherwise the counter is always 0
+uint64_t GetThreadAllocationsCount();
+
+}
@@ -1,12 +1,11 @@
 #include "bone_chain.h"
 #include "light_ik_plugin.h"
+#include "skeleton_topology.h"
 #include "glm/glm.hpp"
 
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <godot_cpp/classes/skeleton3d.hpp>
 
-#include <stack>
-
 namespace godot
 {
 
@@ -87,24 +86,18 @@ void BoneChain::ValidateRootBone(PropertyInfo& info)
     info.hint = PROPERTY_HINT_ENUM;
 
     assert(m_skeleton);
+    auto topology = SkeletonTopology::Get(m_skeleton);
     
     // if tip is not selected allow to chose any bone for root
-    int tipBone = m_skeleton->find_bone(m_tipBoneName);
+    int tipBone = topology->FindBone(m_tipBoneName);
     if (-1 == tipBone)
     {
-        info.hint_string = m_skeleton->get_concatenated_bone_names();
+        info.hint_string = topology->GetBoneNamesHint();
         return;
     }
 
-    // list all parent bones from current tip (including) to skeleton root
-    int32_t bone = tipBone;
-    info.hint_string = "";
-    while (bone >= 0)
-    {
-        // inverse addition to the list to keep the right order of the bones, from root to current
-        info.hint_string = m_skeleton->get_bone_name(bone) + "," + info.hint_string;
-        bone = m_skeleton->get_bone_parent(bone);
-    }
+    // list all parent bones from skeleton root to current tip (including)
+    info.hint_string = topology->GetAncestorsHint(tipBone);
 }
 
 void BoneChain::ValidateTipBone(PropertyInfo& info)
@@ -112,36 +105,18 @@ void BoneChain::ValidateTipBone(PropertyInfo& info)
     info.hint = PROPERTY_HINT_ENUM;
 
     assert(m_skeleton);
+    auto topology = SkeletonTopology::Get(m_skeleton);
 
-    int rootBone = m_skeleton->find_bone(m_rootBoneName);
+    int rootBone = topology->FindBone(m_rootBoneName);
     if (-1 == rootBone)
     {
         // if root is not selected allow to chose any bone for tip
-        info.hint_string = m_skeleton->get_concatenated_bone_names();
+        info.hint_string = topology->GetBoneNamesHint();
         return;
     }
     
-    std::stack<int32_t> boneStack;
     // allow to chose any child bone from the selected root, including the root itself, to make look-at bones
-    
-    boneStack.emplace(rootBone);
-    // create the list of all child bones from current to all branch leaves
-    // avoid recursion. create the stack of bones and process it.
-    
-    while (!boneStack.empty())
-    {
-        int32_t rootBone = boneStack.top();
-        boneStack.pop();
-        // concatenate names of child bones into the single list
-        info.hint_string += m_skeleton->get_bone_name(rootBone) + ",";
-
-        // put all child bones to stack to process them later
-        const auto& bones = m_skeleton->get_bone_children(rootBone);
-        for (int32_t bone : bones)
-        {
-            boneStack.emplace(bone);
-        }
-    }
+    info.hint_string = topology->GetDescendantsHint(rootBone);
 }
 ////////////////////////////////////////////////////////////////////////////////////////////
 /// Standard IK chain 
@@ -196,7 +171,7 @@ void ChainIKBoneLink::_validate_property(godot::PropertyInfo& info)
     if (info.name == String("target_bone"))
     {
         info.hint = PROPERTY_HINT_ENUM;
-        info.hint_string = m_skeleton->get_concatenated_bone_names();
+        info.hint_string = SkeletonTopology::Get(m_skeleton)->GetBoneNamesHint();
     }
 }
 
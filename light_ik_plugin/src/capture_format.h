@@ -0,0 +1,134 @@
+#pragma once
+
+#include "light_ik/light_ik.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace LightIKCapture
+{
+
+// Layout of the capture file. All sections start at aligned offsets and frames have the fixed size,
+// so the file can be memory mapped and frames are accessed by the index without parsing.
+// Solver types are stored as is, the capture is read by the tool built with the same solver and on the same platform
+//
+//  FileHeader
+//  ChainRecord         [chainCount]            in the order of solving, group by group
+//  LightIK::BoneDesc   [boneDescCount]         bones of all root and target chains
+//  ConstraintRecord    [constraintCount]
+//  frames              [frameCount]            FrameHeader, uint32_t solved[maskWords], uint32_t reseeded[maskWords],
+//                                              float targets[chainCount][3], float rotations[boneCount][4]
+//
+// Masks have one bit per group. The capture covers one definition, the plugin starts a new capture when its definition changes
+
+constexpr char      Magic[8]    = {'L', 'I', 'K', 'C', 'A', 'P', 'T', 'R'};
+constexpr uint32_t  Version     = 3;
+constexpr uint64_t  Alignment   = 64;
+
+static_assert(std::is_trivially_copyable_v<LightIK::BoneDesc>);
+static_assert(std::is_trivially_copyable_v<LightIK::Constraints>);
+
+struct FileHeader
+{
+    char        magic[8]            = {};
+    uint32_t    version             = Version;
+    // sizes of solver types, the reader refuses captures of the solver built with other types
+    uint32_t    realSize            = sizeof(LightIK::real);
+    uint32_t    boneDescSize        = sizeof(LightIK::BoneDesc);
+    uint32_t    constraintSize      = sizeof(LightIK::Constraints);
+    uint32_t    boneCount           = 0;
+    uint32_t    chainCount          = 0;
+    uint32_t    boneDescCount       = 0;
+    uint32_t    constraintCount     = 0;
+    uint32_t    frameStride         = 0;
+    uint32_t    groupCount          = 0;
+    uint64_t    chainsOffset        = 0;
+    uint64_t    boneDescsOffset     = 0;
+    uint64_t    constraintsOffset   = 0;
+    uint64_t    framesOffset        = 0;
+    uint64_t    frameCount          = 0;
+};
+
+struct ChainRecord
+{
+    uint32_t    chainIndex          = 0;
+    // chains of the same group are solved by the same controller
+    uint32_t    groupIndex          = 0;
+    int32_t     startBone           = -1;
+    int32_t     targetBone          = -1;
+    // ranges in the array of bone descriptions
+    uint32_t    rootChainFirst      = 0;
+    uint32_t    rootChainCount      = 0;
+    uint32_t    targetChainFirst    = 0;
+    uint32_t    targetChainCount    = 0;
+};
+
+struct ConstraintRecord
+{
+    int32_t                 boneIndex   = -1;
+    LightIK::Constraints    constraint;
+};
+
+// Effective settings of the solver in the frame, the level of detail can change them during the capture
+struct SolverSettings
+{
+    uint32_t    iterations          = 1;
+    // distance between tips and targets at which the solve stops, 0 runs all iterations
+    float       tolerance           = 0;
+    // 0 if every solve starts from the pose the controller was created with
+    uint32_t    warmStart           = 1;
+    uint32_t    padding             = 0;
+};
+
+struct FrameHeader
+{
+    uint64_t        frameIndex      = 0;
+    double          time            = 0;
+    SolverSettings  settings;
+};
+
+inline uint64_t AlignOffset(uint64_t offset)
+{
+    return (offset + Alignment - 1) / Alignment * Alignment;
+}
+
+inline uint32_t GetGroupMaskWords(uint32_t groupCount)
+{
+    return (groupCount + 31) / 32;
+}
+
+inline uint32_t GetFrameStride(uint32_t chainCount, uint32_t boneCount, uint32_t groupCount)
+{
+    size_t size = sizeof(FrameHeader) + GetGroupMaskWords(groupCount) * 2 * sizeof(uint32_t) + (chainCount * 3 + boneCount * 4) * sizeof(float);
+    return (uint32_t)((size + 7) / 8 * 8);
+}
+
+// Groups solved in the frame and groups which controllers were created again from the input pose of the frame before the solve
+inline const uint32_t* GetFrameSolvedMask(const FrameHeader* frame)
+{
+    return reinterpret_cast<const uint32_t*>(frame + 1);
+}
+
+inline const uint32_t* GetFrameReseededMask(const FrameHeader* frame, uint32_t groupCount)
+{
+    return GetFrameSolvedMask(frame) + GetGroupMaskWords(groupCount);
+}
+
+inline bool IsGroupSet(const uint32_t* mask, uint32_t group)
+{
+    return (mask[group / 32] >> (group % 32)) & 1;
+}
+
+// Targets and rotations of the frame follow the masks
+inline const float* GetFrameTargets(const FrameHeader* frame, uint32_t groupCount)
+{
+    return reinterpret_cast<const float*>(GetFrameSolvedMask(frame) + GetGroupMaskWords(groupCount) * 2);
+}
+
+inline const float* GetFrameRotations(const FrameHeader* frame, uint32_t groupCount, uint32_t chainCount)
+{
+    return GetFrameTargets(frame, groupCount) + chainCount * 3;
+}
+
+}
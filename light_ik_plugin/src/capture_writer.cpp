@@ -0,0 +1,216 @@
+#include "capture_writer.h"
+
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace godot
+{
+
+using namespace LightIKCapture;
+
+template <typename T>
+static void AppendBytes(std::vector<uint8_t>& block, const T& value)
+{
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&value);
+    block.insert(block.end(), data, data + sizeof(T));
+}
+
+static void SetGroups(uint32_t* mask, uint32_t maskWords, const std::vector<uint32_t>& groups)
+{
+    std::fill(mask, mask + maskWords, 0u);
+    for (uint32_t group : groups)
+    {
+        if (group / 32 < maskWords)
+        {
+            mask[group / 32] |= 1u << (group % 32);
+        }
+    }
+}
+
+static void AlignBlock(std::vector<uint8_t>& block)
+{
+    block.resize(AlignOffset(block.size()), 0);
+}
+
+CaptureWriter::CaptureWriter(const RigDefinition& definition, uint32_t ringFrames)
+    : m_ringFrames(std::max(ringFrames, 1u))
+{
+    // Chains are stored in the order they are solved, group by group. Chains refer to ranges of the common array of bones
+    std::vector<ChainRecord> chains;
+    std::vector<LightIK::BoneDesc> bones;
+    for (size_t g = 0; g < definition.groups.size(); ++g)
+    {
+        for (size_t c : definition.groups[g])
+        {
+            const ChainDefinition& chain = definition.chains[c];
+            ChainRecord record;
+            record.chainIndex       = chain.chainIndex;
+            record.groupIndex       = (uint32_t)g;
+            record.startBone        = chain.startBone;
+            record.targetBone       = chain.targetBone;
+            record.rootChainFirst   = (uint32_t)bones.size();
+            record.rootChainCount   = (uint32_t)chain.rootChain.size();
+            bones.insert(bones.end(), chain.rootChain.begin(), chain.rootChain.end());
+            record.targetChainFirst = (uint32_t)bones.size();
+            record.targetChainCount = (uint32_t)chain.targetChain.size();
+            bones.insert(bones.end(), chain.targetChain.begin(), chain.targetChain.end());
+            chains.emplace_back(record);
+        }
+    }
+
+    std::memcpy(m_header.magic, Magic, sizeof(Magic));
+    m_header.boneCount          = (uint32_t)definition.boneCount;
+    m_header.chainCount         = (uint32_t)chains.size();
+    m_header.boneDescCount      = (uint32_t)bones.size();
+    m_header.constraintCount    = (uint32_t)definition.constraints.size();
+    m_header.groupCount         = (uint32_t)definition.groups.size();
+    m_header.frameStride        = GetFrameStride(m_header.chainCount, m_header.boneCount, m_header.groupCount);
+
+    // the header is written the last, when offsets of all sections are known
+    m_definitionBlock.resize(AlignOffset(sizeof(FileHeader)), 0);
+    m_header.chainsOffset = m_definitionBlock.size();
+    for (const ChainRecord& record : chains)
+    {
+        AppendBytes(m_definitionBlock, record);
+    }
+    AlignBlock(m_definitionBlock);
+
+    m_header.boneDescsOffset = m_definitionBlock.size();
+    for (const LightIK::BoneDesc& bone : bones)
+    {
+        AppendBytes(m_definitionBlock, bone);
+    }
+    AlignBlock(m_definitionBlock);
+
+    m_header.constraintsOffset = m_definitionBlock.size();
+    for (const BoneConstraint& constraint : definition.constraints)
+    {
+        AppendBytes(m_definitionBlock, ConstraintRecord{constraint.boneIndex, constraint.constraint});
+    }
+    AlignBlock(m_definitionBlock);
+
+    m_header.framesOffset = m_definitionBlock.size();
+    m_frame.resize(m_header.frameStride, 0);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+    Close();
+}
+
+bool CaptureWriter::Open(const String& path)
+{
+    Close();
+    m_file = FileAccess::open(path, FileAccess::WRITE);
+    if (m_file.is_null())
+    {
+        UtilityFunctions::push_error("Capture file ", path, " cannot be opened");
+        return false;
+    }
+
+    // the number of frames is updated when the file is closed
+    m_framesCount = 0;
+    StoreBytes(**m_file, m_definitionBlock.data(), m_definitionBlock.size());
+    WriteHeader(**m_file, 0);
+    m_file->seek_end();
+    return true;
+}
+
+void CaptureWriter::Close()
+{
+    if (m_file.is_valid())
+    {
+        WriteHeader(**m_file, m_framesCount);
+        m_file->close();
+        m_file.unref();
+    }
+}
+
+void CaptureWriter::AddFrame(double time, const SolverSettings& settings, const std::vector<uint32_t>& solvedGroups, 
+                             const std::vector<uint32_t>& reseededGroups, const std::vector<Vector3>& targets, const std::vector<Quaternion>& rotations)
+{
+    FrameHeader header;
+    header.frameIndex   = m_framesCount;
+    header.time         = time;
+    header.settings     = settings;
+    std::memcpy(m_frame.data(), &header, sizeof(header));
+
+    uint32_t maskWords = GetGroupMaskWords(m_header.groupCount);
+    uint32_t* masks = reinterpret_cast<uint32_t*>(m_frame.data() + sizeof(FrameHeader));
+    SetGroups(masks, maskWords, solvedGroups);
+    SetGroups(masks + maskWords, maskWords, reseededGroups);
+
+    float* data = reinterpret_cast<float*>(masks + maskWords * 2);
+    for (uint32_t c = 0; c < m_header.chainCount; ++c)
+    {
+        Vector3 target = c < targets.size() ? targets[c] : Vector3();
+        *data++ = (float)target.x;
+        *data++ = (float)target.y;
+        *data++ = (float)target.z;
+    }
+    for (uint32_t bone = 0; bone < m_header.boneCount; ++bone)
+    {
+        Quaternion rotation = bone < rotations.size() ? rotations[bone] : Quaternion();
+        *data++ = (float)rotation.x;
+        *data++ = (float)rotation.y;
+        *data++ = (float)rotation.z;
+        *data++ = (float)rotation.w;
+    }
+
+    if (m_file.is_valid())
+    {
+        StoreBytes(**m_file, m_frame.data(), m_frame.size());
+    }
+    else
+    {
+        // the ring buffer grows up to its capacity, then the oldest frame is overwritten
+        size_t slot = (m_framesCount % m_ringFrames) * m_header.frameStride;
+        if (m_ring.size() < slot + m_header.frameStride)
+        {
+            m_ring.resize(slot + m_header.frameStride);
+        }
+        std::memcpy(m_ring.data() + slot, m_frame.data(), m_frame.size());
+    }
+    ++m_framesCount;
+}
+
+bool CaptureWriter::Save(const String& path) const
+{
+    Ref<FileAccess> file = FileAccess::open(path, FileAccess::WRITE);
+    if (file.is_null())
+    {
+        UtilityFunctions::push_error("Capture file ", path, " cannot be opened");
+        return false;
+    }
+
+    // frames are stored from the oldest to the newest
+    uint64_t framesCount = std::min<uint64_t>(m_framesCount, m_ringFrames);
+    uint64_t firstFrame  = m_framesCount - framesCount;
+    StoreBytes(**file, m_definitionBlock.data(), m_definitionBlock.size());
+    for (uint64_t frame = firstFrame; frame < m_framesCount; ++frame)
+    {
+        StoreBytes(**file, m_ring.data() + (frame % m_ringFrames) * m_header.frameStride, m_header.frameStride);
+    }
+    WriteHeader(**file, framesCount);
+    file->close();
+    return true;
+}
+
+void CaptureWriter::WriteHeader(FileAccess& file, uint64_t framesCount) const
+{
+    FileHeader header = m_header;
+    header.frameCount = framesCount;
+    file.seek(0);
+    StoreBytes(file, reinterpret_cast<const uint8_t*>(&header), sizeof(header));
+}
+
+void CaptureWriter::StoreBytes(FileAccess& file, const uint8_t* data, size_t size) const
+{
+    m_storeBuffer.resize(size);
+    std::memcpy(m_storeBuffer.ptrw(), data, size);
+    file.store_buffer(m_storeBuffer);
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "capture_format.h"
+#include "rig_definition.h"
+
+#include <godot_cpp/classes/file_access.hpp>
+#include <godot_cpp/classes/skeleton3d.hpp>
+
+#include <vector>
+
+namespace godot
+{
+
+/// @brief Writes inputs of the solver to the capture. The rig definition is captured once when the capture starts,
+/// then every solved frame adds groups it solved and reseeded, targets of all chains and the incoming pose of the skeleton.
+/// Frames are either streamed to the file or kept in the ring buffer of the last frames.
+/// The capture is valid only for the definition it was started with, groups of the definition are the solved groups
+class CaptureWriter
+{
+public:
+    CaptureWriter(const RigDefinition& definition, uint32_t ringFrames);
+    ~CaptureWriter();
+
+    // Streams all frames to the file, without the file frames are kept in the ring buffer
+    bool Open(const String& path);
+    void Close();
+
+    // groups are indices of groups of the captured definition, targets are in the skeleton space, one for each chain 
+    // of the captured definition in the order of its groups, rotations are local pose rotations of all bones
+    void AddFrame(double time, const LightIKCapture::SolverSettings& settings, const std::vector<uint32_t>& solvedGroups, 
+                  const std::vector<uint32_t>& reseededGroups, const std::vector<Vector3>& targets, const std::vector<Quaternion>& rotations);
+    // Saves the content of the ring buffer
+    bool Save(const String& path) const;
+
+    uint64_t GetFramesCount() const                 { return m_framesCount; }
+
+private:
+    void WriteHeader(FileAccess& file, uint64_t framesCount) const;
+    void StoreBytes(FileAccess& file, const uint8_t* data, size_t size) const;
+
+    LightIKCapture::FileHeader  m_header;
+    // header is followed by chains, bones and constraints, the block is written as is to every capture
+    std::vector<uint8_t>        m_definitionBlock;
+
+    std::vector<uint8_t>        m_frame;
+    std::vector<uint8_t>        m_ring;
+    uint32_t                    m_ringFrames    = 0;
+    uint64_t                    m_framesCount   = 0;
+
+    Ref<FileAccess>             m_file;
+    mutable PackedByteArray     m_storeBuffer;
+};
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "light_ik/light_ik.h"
+
+#include <godot_cpp/variant/vector3.hpp>
+#include <godot_cpp/variant/quaternion.hpp>
+
+namespace godot
+{
+
+// Conversion between Godot and LightIK types. LightIK quaternions store w component first, Godot ones store it last
+static inline Vector3 FromLightIKVector(const LightIK::Vector& src)
+{
+    return Vector3{(real_t)src.x, (real_t)src.y, (real_t)src.z};
+}
+
+static inline LightIK::Vector ToLightIKVector(const Vector3& src)
+{
+    return LightIK::Vector{(LightIK::real)src.x, (LightIK::real)src.y, (LightIK::real)src.z};
+}
+
+static inline LightIK::Quaternion ToLightIKQuaternion(const Quaternion& quat)
+{
+    return LightIK::Quaternion{(LightIK::real)quat.w, (LightIK::real)quat.x, (LightIK::real)quat.y, (LightIK::real)quat.z};
+}
+
+static inline Quaternion FromLightIKQuaternion(const LightIK::Quaternion& quat)
+{
+    return Quaternion{(real_t)quat.x, (real_t)quat.y, (real_t)quat.z, (real_t)quat.w};
+}
+
+}
@@ -1,4 +1,5 @@
 #include "joint_constraints.h"
+#include "skeleton_topology.h"
 #include "glm/glm.hpp"
 
 #include <godot_cpp/variant/utility_functions.hpp>
@@ -127,7 +128,7 @@ void JointConstraints::ValidateBone(PropertyInfo& info)
     info.hint = PROPERTY_HINT_ENUM;
 
     // if root is not selected allow to chose any bone for tip
-    info.hint_string = m_skeleton->get_concatenated_bone_names();
+    info.hint_string = SkeletonTopology::Get(m_skeleton)->GetBoneNamesHint();
 }
 
 }
\ No newline at end of file
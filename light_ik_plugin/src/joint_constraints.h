@@ -15,6 +15,8 @@ struct ConstraintData
     double  flexibility     {1};  
     int rotationOrder       = 0;
     int rotationDirection   = 1;
+
+    bool operator==(const ConstraintData& other) const = default;
 };
 
 class JointConstraints : public Resource
@@ -0,0 +1,54 @@
+#include "light_ik_lod.h"
+
+namespace godot
+{
+
+void LightIKLodTier::_bind_methods()
+{
+    DECLARE_UNSCOPED_PROPERTY(LightIKLodTier, distance,             (Variant::FLOAT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKLodTier, iterations_count,     (Variant::INT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKLodTier, update_rate_divisor,  (Variant::INT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKLodTier, disabled_chains,      (Variant::PACKED_INT32_ARRAY));
+}
+
+void LightIKLodTier::set_distance(const float& distance) 
+{
+    m_distance = Math::max(distance, 0.f);
+}
+
+float LightIKLodTier::get_distance() const 
+{
+    return m_distance; 
+}
+
+void LightIKLodTier::set_iterations_count(const int& count) 
+{
+    m_iterationsCount = Math::max(count, 0);
+}
+
+int LightIKLodTier::get_iterations_count() const 
+{
+    return m_iterationsCount; 
+}
+
+void LightIKLodTier::set_update_rate_divisor(const int& divisor) 
+{
+    m_updateRateDivisor = Math::max(divisor, 1);
+}
+
+int LightIKLodTier::get_update_rate_divisor() const 
+{
+    return m_updateRateDivisor; 
+}
+
+void LightIKLodTier::set_disabled_chains(const PackedInt32Array& chains) 
+{
+    m_disabledChains = chains;
+}
+
+PackedInt32Array LightIKLodTier::get_disabled_chains() const 
+{
+    return m_disabledChains; 
+}
+
+}
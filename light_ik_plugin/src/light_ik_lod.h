@@ -0,0 +1,36 @@
+#pragma once
+
+#include "helpers.h"
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/variant/packed_int32_array.hpp>
+
+namespace godot
+{
+
+/// @brief Level of detail of the IK solver. The tier is used while the camera is closer to the skeleton than its distance
+class LightIKLodTier : public Resource
+{
+    GDCLASS(LightIKLodTier, Resource)
+    DEFINE_PROPERTY(float,  distance);
+    DEFINE_PROPERTY(int,    iterations_count);
+    DEFINE_PROPERTY(int,    update_rate_divisor);
+    DEFINE_PROPERTY(PackedInt32Array, disabled_chains);
+
+public:
+    float GetDistance() const                               { return m_distance;            }
+    // 0 keeps the iterations count of the plugin
+    int GetIterationsCount() const                          { return m_iterationsCount;     }
+    int GetUpdateRateDivisor() const                        { return m_updateRateDivisor;   }
+    // indices of chains in bone_chains array that are not solved on this tier
+    const PackedInt32Array& GetDisabledChains() const       { return m_disabledChains;      }
+
+protected:
+    static void _bind_methods();
+
+    float               m_distance          = 0;
+    int                 m_iterationsCount   = 0;
+    int                 m_updateRateDivisor = 1;
+    PackedInt32Array    m_disabledChains;
+};
+
+}
@@ -1,47 +1,94 @@
 #include "light_ik_plugin.h"
 #include "joint_constraints.h"
 #include "visual_helper.h"
+#include "skeleton_topology.h"
+#include "conversions.h"
+#include "light_ik_server.h"
+#include "light_ik_lod.h"
+#include "allocation_tracker.h"
+#include "capture_writer.h"
+#include "rig_cache.h"
 
 #include <godot_cpp/variant/utility_functions.hpp>
 #include <godot_cpp/classes/engine.hpp>
 #include <godot_cpp/classes/skeleton3d.hpp>
+#include <godot_cpp/classes/time.hpp>
+#include <godot_cpp/classes/camera3d.hpp>
+#include <godot_cpp/classes/viewport.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
 
 #include <stack>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iterator>
 #include <glm/ext/scalar_constants.hpp>
 
 namespace godot
 {
-    
-static inline Vector3 FromLightIKVector(const LightIK::Vector& src)
-{
-    return Vector3{(real_t)src.x, (real_t)src.y, (real_t)src.z};
-}
-
-static inline LightIK::Vector ToLightIKVector(const Vector3& src)
-{
-    return LightIK::Vector{(LightIK::real)src.x, (LightIK::real)src.y, (LightIK::real)src.z};
-}
 
-static inline LightIK::Quaternion ToLightIKQuaternion(const Quaternion& quat)
+// The dot product of close rotations is too close to 1 to resolve small angles, especially in float precision.
+// The length of the vector part of the difference is the sine of the half angle, so it keeps small angles precise
+static bool IsRotationChanged(const Quaternion& from, const Quaternion& to)
 {
-    return LightIK::Quaternion{(LightIK::real)quat.w, (LightIK::real)quat.x, (LightIK::real)quat.y, (LightIK::real)quat.z};
+    Quaternion difference = from.inverse() * to;
+    return 2 * Vector3(difference.x, difference.y, difference.z).length() > settingRotationEpsilon;
 }
 
-static inline Quaternion FromLightIKQuaternion(const LightIK::Quaternion& quat)
+static LightIK::real GetDistanceSquared(const LightIK::Vector& a, const LightIK::Vector& b)
 {
-    return Quaternion{(real_t)quat.x, (real_t)quat.y, (real_t)quat.z, (real_t)quat.w};
+    LightIK::real dx = a.x - b.x;
+    LightIK::real dy = a.y - b.y;
+    LightIK::real dz = a.z - b.z;
+    return dx * dx + dy * dy + dz * dz;
 }
 
 void LightIKPlugin::_bind_methods()
 {
     DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, simulate,           (Variant::BOOL));
     DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, iterations_count,   (Variant::INT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, tolerance,          (Variant::FLOAT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, skip_threshold,     (Variant::FLOAT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, warm_start,         (Variant::BOOL));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, warm_start_reset_distance, (Variant::FLOAT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, update_rate_hz,     (Variant::FLOAT));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, parallel_solve,     (Variant::BOOL));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, batch_solve,        (Variant::BOOL));
+    
+    ClassDB::bind_method(D_METHOD("get_chain_residual", "chain_index"), &LightIKPlugin::get_chain_residual);
+    ClassDB::bind_method(D_METHOD("get_chain_iterations", "chain_index"), &LightIKPlugin::get_chain_iterations);
+    ClassDB::bind_method(D_METHOD("get_solves_count"), &LightIKPlugin::get_solves_count);
+    ClassDB::bind_method(D_METHOD("get_skipped_solves_count"), &LightIKPlugin::get_skipped_solves_count);
+    ClassDB::bind_method(D_METHOD("get_solve_stats"), &LightIKPlugin::get_solve_stats);
     
     ADD_GROUP("Visualization", "helpers_");
     DECLARE_PROPERTY(LightIKPlugin, show_helpers,       (Variant::BOOL), helpers);
     DECLARE_PROPERTY(LightIKPlugin, marker_radius,      (Variant::FLOAT), helpers);
     DECLARE_PROPERTY(LightIKPlugin, constraint_radius,  (Variant::FLOAT), helpers);
 
+    ClassDB::bind_method(D_METHOD("get_rig"), &LightIKPlugin::get_rig);
+    ClassDB::bind_method(D_METHOD("set_rig", "rig"), &LightIKPlugin::set_rig);
+    ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "rig", PROPERTY_HINT_RESOURCE_TYPE, "LightIKRig"), "set_rig", "get_rig");
+
+    ClassDB::bind_method(D_METHOD("get_lod_tier"), &LightIKPlugin::get_lod_tier);
+
+    ADD_GROUP("Level of Detail", "lod_");
+
+    ClassDB::bind_method(D_METHOD("get_lod_tiers"), &LightIKPlugin::get_lod_tiers);
+    ClassDB::bind_method(D_METHOD("set_lod_tiers", "lod_tiers"), &LightIKPlugin::set_lod_tiers);
+    ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "lod_tiers", PROPERTY_HINT_TYPE_STRING, 
+            String::num(Variant::OBJECT) + "/" + String::num(PROPERTY_HINT_RESOURCE_TYPE) + ":LightIKLodTier"), "set_lod_tiers", "get_lod_tiers");
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, lod_suspend_offscreen,  (Variant::BOOL));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, lod_visibility_radius,  (Variant::FLOAT));
+
+    ClassDB::bind_method(D_METHOD("save_capture", "path"), &LightIKPlugin::save_capture);
+
+    ADD_GROUP("Capture", "capture_");
+    DECLARE_UNSCOPED_ENUM_PROPERTY(LightIKPlugin, capture_mode, "Disabled:0,File:1,Ring Buffer:2");
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, capture_path,          (Variant::STRING));
+    DECLARE_UNSCOPED_PROPERTY(LightIKPlugin, capture_ring_frames,   (Variant::INT));
+
     ADD_GROUP("Bone Chains", "chains_");
 
     ClassDB::bind_method(D_METHOD("get_bone_chains"), &LightIKPlugin::get_bone_chains);
@@ -55,12 +102,17 @@ void LightIKPlugin::_bind_methods()
     ClassDB::bind_method(D_METHOD("set_constraints_array", "constraints_array"), &LightIKPlugin::set_constraints_array);
     ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "constraints_constraints_array", PROPERTY_HINT_TYPE_STRING, 
             String::num(Variant::OBJECT) + "/" + String::num(PROPERTY_HINT_RESOURCE_TYPE) + ":JointConstraints"), "set_constraints_array", "get_constraints_array");
+
+    ClassDB::bind_method(D_METHOD("get_compiled_rig"), &LightIKPlugin::get_compiled_rig);
+    ClassDB::bind_method(D_METHOD("set_compiled_rig", "compiled_rig"), &LightIKPlugin::set_compiled_rig);
+    ADD_PROPERTY(PropertyInfo(Variant::PACKED_BYTE_ARRAY, "compiled_rig", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE), "set_compiled_rig", "get_compiled_rig");
 }
 
 ////////////////////////////////////////////// properties definition
 void LightIKPlugin::set_iterations_count(const int& interations) 
 {
     m_iterationsCount = interations;
+    InvalidateSolution();
 }
 
 int LightIKPlugin::get_iterations_count() const 
@@ -68,13 +120,107 @@ int LightIKPlugin::get_iterations_count() const
     return m_iterationsCount; 
 }
 
+void LightIKPlugin::set_tolerance(const float& tolerance) 
+{
+    // if tolerance is set, iterations count becomes the upper limit of iterations per frame
+    m_tolerance = Math::max(tolerance, 0.f);
+    InvalidateSolution();
+}
+
+float LightIKPlugin::get_tolerance() const 
+{
+    return m_tolerance; 
+}
+
+void LightIKPlugin::set_skip_threshold(const float& threshold) 
+{
+    // targets that moved less than the threshold since the last solve are considered static
+    m_skipThreshold = Math::max(threshold, 0.f);
+}
+
+float LightIKPlugin::get_skip_threshold() const 
+{
+    return m_skipThreshold; 
+}
+
+void LightIKPlugin::set_warm_start(const bool& warm_start) 
+{
+    // with warm start the solver continues from the solution of the previous frame, 
+    // otherwise every solve starts from the pose captured at build time
+    m_warmStart = warm_start;
+    InvalidateSolution();
+}
+
+bool LightIKPlugin::get_warm_start() const 
+{
+    return m_warmStart; 
+}
+
+void LightIKPlugin::set_warm_start_reset_distance(const float& distance) 
+{
+    m_warmStartResetDistance = Math::max(distance, 0.f);
+}
+
+float LightIKPlugin::get_warm_start_reset_distance() const 
+{
+    return m_warmStartResetDistance; 
+}
+
+void LightIKPlugin::set_update_rate_hz(const float& rate) 
+{
+    m_updateRateHz = Math::max(rate, 0.f);
+    // the new rate starts from the solve in the next frame
+    m_lastSolveTicks = 0;
+}
+
+float LightIKPlugin::get_update_rate_hz() const 
+{
+    return m_updateRateHz; 
+}
+
+float LightIKPlugin::get_chain_residual(int chain_index) const
+{
+    const ChainSolver* solver = FindChainSolver(chain_index);
+    return solver ? solver->residual : -1.f;
+}
+
+int LightIKPlugin::get_chain_iterations(int chain_index) const
+{
+    const ChainSolver* solver = FindChainSolver(chain_index);
+    return solver ? solver->iterations : 0;
+}
+
+void LightIKPlugin::set_parallel_solve(const bool& parallel) 
+{
+    m_parallelSolve = parallel;
+}
+
+bool LightIKPlugin::get_parallel_solve() const 
+{
+    return m_parallelSolve; 
+}
+
+void LightIKPlugin::set_batch_solve(const bool& batch) 
+{
+    m_batchSolve = batch;
+}
+
+bool LightIKPlugin::get_batch_solve() const 
+{
+    return m_batchSolve; 
+}
+
 void LightIKPlugin::set_simulate(const bool& animate) 
 {
     m_simulate = animate;
     if (!m_simulate && get_skeleton())
     {
         get_skeleton()->clear_bones_global_pose_override();
-        m_controllerIK->ResetPose();
+        for (auto& group : m_groups)
+        {
+            group.controller->ResetPose();
+        }
+        InvalidateSolution();
     }
 }
 
@@ -87,6 +233,8 @@ void LightIKPlugin::set_show_helpers(const bool& show)
 {
     m_showHelpers = show;
     m_helper->Enable(show);
+    // the data could be outdated while helpers were hidden
+    m_visualVersion = UINT64_MAX;
 }
 bool LightIKPlugin::get_show_helpers() const 
 {
@@ -111,6 +259,108 @@ float LightIKPlugin::get_constraint_radius() const
     return m_helper->GetConstraintMarkerRadius(); 
 }
 
+void LightIKPlugin::set_lod_tiers(const TypedArray<LightIKLodTier>& tiers) 
+{
+    m_lodTiers = tiers;
+    // the tier is picked again in the next frame
+    m_lodTier = -2;
+}
+
+TypedArray<LightIKLodTier> LightIKPlugin::get_lod_tiers() const 
+{
+    return m_lodTiers; 
+}
+
+void LightIKPlugin::set_lod_suspend_offscreen(const bool& suspend) 
+{
+    m_lodSuspendOffscreen = suspend;
+}
+
+bool LightIKPlugin::get_lod_suspend_offscreen() const 
+{
+    return m_lodSuspendOffscreen; 
+}
+
+void LightIKPlugin::set_lod_visibility_radius(const float& radius) 
+{
+    m_lodVisibilityRadius = Math::max(radius, 0.f);
+}
+
+float LightIKPlugin::get_lod_visibility_radius() const 
+{
+    return m_lodVisibilityRadius; 
+}
+
+void LightIKPlugin::set_capture_mode(const int& mode) 
+{
+    // the capture starts again in the next solved frame
+    StopCapture();
+    m_captureMode = Math::clamp(mode, (int)CaptureDisabled, (int)CaptureRingBuffer);
+}
+
+int LightIKPlugin::get_capture_mode() const 
+{
+    return m_captureMode; 
+}
+
+void LightIKPlugin::set_capture_path(const String& path) 
+{
+    if (m_captureMode == CaptureFile)
+    {
+        StopCapture();
+    }
+    m_capturePath = path;
+}
+
+String LightIKPlugin::get_capture_path() const 
+{
+    return m_capturePath; 
+}
+
+void LightIKPlugin::set_capture_ring_frames(const int& frames) 
+{
+    if (m_captureMode == CaptureRingBuffer)
+    {
+        StopCapture();
+    }
+    m_captureRingFrames = Math::max(frames, 1);
+}
+
+int LightIKPlugin::get_capture_ring_frames() const 
+{
+    return m_captureRingFrames; 
+}
+
+void LightIKPlugin::set_rig(const Ref<LightIKRig>& rig) 
+{
+    m_rig = rig;
+    if (!is_node_ready())
+    {
+        return;
+    }
+
+    if (m_rig.is_valid())
+    {
+        m_rig->_ready(get_skeleton());
+    }
+    RequestBuild(true);
+}
+
+Ref<LightIKRig> LightIKPlugin::get_rig() const 
+{
+    return m_rig; 
+}
+
+TypedArray<BoneChain> LightIKPlugin::GetBoneChains() const
+{
+    return m_rig.is_valid() ? m_rig->get_bone_chains() : m_boneChains;
+}
+
+TypedArray<JointConstraints> LightIKPlugin::GetConstraintsArray() const
+{
+    return m_rig.is_valid() ? m_rig->get_constraints_array() : m_constraintsArray;
+}
+
 void LightIKPlugin::set_bone_chains(const TypedArray<BoneChain>& array) 
 {
     if (!is_node_ready())
@@ -119,17 +369,22 @@ void LightIKPlugin::set_bone_chains(const TypedArray<BoneChain>& array)
         return;
     }
 
+    // chains that were not changed keep their state, changed instances are rebuilt from their new parameters
     m_boneChains = array;
+    std::unordered_set<uint64_t> dirtyChains;
     for (size_t i = 0; i < m_boneChains.size(); ++i)
     {
         auto chain = Object::cast_to<BoneChain>(m_boneChains[i]);
         if (chain)
         {
             chain->_ready(get_skeleton());
+            if (chain->IsDirty())
+            {
+                dirtyChains.insert(chain->get_instance_id());
+            }
         }
     }
-
-    BuildChains();
+    RequestBuild(m_rig.is_valid(), dirtyChains);
 }
 
 TypedArray<BoneChain> LightIKPlugin::get_bone_chains() const 
@@ -162,6 +417,16 @@ TypedArray<JointConstraints> LightIKPlugin::get_constraints_array() const
     return m_constraintsArray; 
 }
 
+void LightIKPlugin::set_compiled_rig(const PackedByteArray& data) 
+{
+    m_compiledRig = data;
+}
+
+PackedByteArray LightIKPlugin::get_compiled_rig() const 
+{
+    return m_compiledRig; 
+}
+
 LightIKPlugin::LightIKPlugin()
     : m_helper(memnew(VisualHelper))
 {
@@ -170,10 +435,33 @@ LightIKPlugin::LightIKPlugin()
 
 LightIKPlugin::~LightIKPlugin()
 {
-
+    // the pending build refers to the plugin
+    WaitBuild();
+    StopCapture();
 }
 
 ////////////////////////////////////////////// godot interface
+void LightIKPlugin::_enter_tree()
+{
+    if (LightIKServer::get_singleton())
+    {
+        LightIKServer::get_singleton()->Register(this);
+    }
+}
+
+void LightIKPlugin::_exit_tree()
+{
+    if (LightIKServer::get_singleton())
+    {
+        LightIKServer::get_singleton()->Unregister(this);
+    }
+    // the file of the capture is finalized, the ring buffer is kept until the capture is restarted
+    if (m_captureMode == CaptureFile)
+    {
+        StopCapture();
+    }
+}
+
 void LightIKPlugin::_ready()
 {
     m_helper->set_owner(this);
@@ -181,8 +469,11 @@ void LightIKPlugin::_ready()
     // so parameters should be updated at the moment the object is fully constructed
     assert (get_skeleton());
 
-    m_controllerIK = std::make_unique<LightIK::LightIK>(get_skeleton()->get_bone_count());
-    
+    if (m_rig.is_valid())
+    {
+        m_rig->_ready(get_skeleton());
+    }
+
     for (size_t i = 0; i < m_boneChains.size(); ++i)
     {
         BoneChain* chain = Object::cast_to<BoneChain>(m_boneChains[i]);
@@ -192,8 +483,6 @@ void LightIKPlugin::_ready()
         }
     }
 
-    BuildChains();
-
     for (size_t i = 0; i < m_constraintsArray.size(); ++i)
     {
         JointConstraints* constraint = Object::cast_to<JointConstraints>(m_constraintsArray[i]);
@@ -203,36 +492,101 @@ void LightIKPlugin::_ready()
         }
     }
 
-    BuildConstraints();
+    // constraints are applied to the controllers of the groups during the build, 
+    // the build is started in the next process together with all other requests of the frame
+    RequestBuild(true);
+
+    if constexpr (settingEnableDebugging)
+    {
+        // the skeleton notifies about the changes of its pose, so helpers are not rebuilt while the pose is the same
+        Callable poseUpdated = callable_mp(this, &LightIKPlugin::OnPoseUpdated);
+        if (!get_skeleton()->is_connected("pose_updated", poseUpdated))
+        {
+            get_skeleton()->connect("pose_updated", poseUpdated);
+        }
+    }
+}
+
+void LightIKPlugin::OnPoseUpdated()
+{
+    ++m_poseVersion;
 }
 
-void LightIKPlugin::_process_modification()
+const SkeletonPose& LightIKPlugin::GetFramePose()
 {
-    if (!is_inside_tree() || !is_node_ready() || !m_simulate || !m_controllerIK)
+    // the batch solve prepares other plugins before their modification, then the pose is read here.
+    // The snapshot of the previous topology is read again after the skeleton has changed
+    if (m_framePoseFrame != LightIKServer::GetFrameKey() || m_framePose.rotations.size() != (size_t)m_topology->GetBoneCount())
     {
-        return;
+        m_framePose.Read(get_skeleton(), *m_topology, m_framePoseBones);
+        m_framePoseFrame = LightIKServer::GetFrameKey();
+        m_framePoseFull  = false;
+        m_framePoseDirty = false;
     }
-    
-    // Calculate positions of all external targets. The target position is calculated in skeleton relative coordinates
-    Transform3D skeletonPosition = get_skeleton()->get_global_transform();
-    for (auto& target : m_targets)
+    return m_framePose;
+}
+
+const SkeletonPose& LightIKPlugin::GetFrameGlobals()
+{
+    // the snapshot of the solver bones is completed by all bones, rotations written by the solution are read back as they are
+    if (m_framePoseFrame != LightIKServer::GetFrameKey() || m_framePose.rotations.size() != (size_t)m_topology->GetBoneCount() || !m_framePoseFull)
+    {
+        m_framePose.Read(get_skeleton(), *m_topology);
+        m_framePoseFrame = LightIKServer::GetFrameKey();
+        m_framePoseFull  = true;
+        m_framePoseDirty = false;
+    }
+    else if (m_framePoseDirty)
     {
-        Vector3 localPosition = skeletonPosition.affine_inverse().xform(target.target->get_global_transform().origin);
-        target.pos->SetPosition(ToLightIKVector(localPosition));
+        m_framePose.UpdateGlobals(*m_topology);
+        m_framePoseDirty = false;
+    }
+    return m_framePose;
+}
+
+void LightIKPlugin::_process_modification()
+{
+    // the level of detail can disable all chains, the plugin keeps processing to pick the tier that enables them again
+    if (!is_inside_tree() || !is_node_ready() || !m_simulate || !m_definition)
+    {
+        return;
     }
 
-    // Process all chains
-    m_controllerIK->Update(m_iterationsCount);
+    // modifiers before this one could change the pose, so the snapshot taken by the batch is dropped. The pose is read again
+    // only if the frame solves or applies the solution, suspended and skipped frames don't touch the skeleton
+    m_framePoseFrame = UINT64_MAX;
 
-    // Update rotations of all bones
-    auto& deltas = m_controllerIK->GetDeltaRotations();
-    for (int32_t index = 0; index < deltas.size(); ++index)
+    m_modificationFrame = LightIKServer::GetCallbackFrame(get_skeleton());
+    if (m_batchSolve && LightIKServer::get_singleton())
     {
-        if (deltas[index])
+        // The first plugin of the frame solves all plugins in one batch, the rest only apply their solutions.
+        // Their inputs were read by the batch before the earlier modifiers of their skeletons, so they lag one frame
+        if (m_batchFrame != LightIKServer::GetFrameKey())
         {
-            get_skeleton()->set_bone_pose_rotation(index, FromLightIKQuaternion(*deltas[index]));
+            LightIKServer::get_singleton()->SolveFrame(this);
         }
     }
+    else
+    {
+        SolvePending(PrepareSolve());
+    }
+
+    CollectStats();
+
+    // suspended skeletons are left to the animation
+    if (m_lodSuspended)
+    {
+        return;
+    }
+
+    // Between solver ticks the output is interpolated from the previous to the last solution
+    real_t weight = 1;
+    if (GetUpdateRate() > 0)
+    {
+        uint64_t elapsed = Time::get_singleton()->get_ticks_usec() - m_lastSolveTicks;
+        weight = Math::clamp((real_t)(elapsed * GetUpdateRate() * 1e-6), (real_t)0, (real_t)1);
+    }
+    ApplySolution(weight);
     
     if constexpr (settingEnableDebugging)
     {
@@ -240,210 +594,974 @@ void LightIKPlugin::_process_modification()
         if (m_showHelpers)
         {
             assert(get_skeleton());
-            UpdateChainsVisualData();
-            UpdateConstraintsVisualData();
+            UpdateVisualData();
         }
     }
 }
 
-void LightIKPlugin::_process(double delta)
+uint32_t LightIKPlugin::PrepareSolve()
 {
-    // Update data of visual helpers
-    if constexpr (settingAllowRuntimeModification)
+    m_pendingGroups.clear();
+    if (!is_inside_tree() || !is_node_ready() || !m_simulate || !m_definition)
     {
-        if (godot::Engine::get_singleton()->is_editor_hint())
-        {
-            UpdateSkeletonParameters();
-        }
+        return 0;
     }
 
-    if constexpr (settingEnableDebugging)
+    // the tier is updated even without groups, the nearer tier can enable chains disabled by the current one
+    UpdateLod();
+    if (m_lodSuspended || m_groups.empty())
     {
-        // update chains visual data if required
-        if (m_showHelpers && !m_simulate)
-        {
-            assert(get_skeleton());
-            UpdateChainsVisualData();
-            UpdateConstraintsVisualData();
-        }
+        return 0;
     }
-}
 
-void LightIKPlugin::BuildChains()
-{
-    m_targets.clear();
-    get_skeleton()->clear_bones_global_pose_override();
-    m_controllerIK->Reset();
+    // with decimated update rate the solver runs only on its ticks
+    uint64_t now = Time::get_singleton()->get_ticks_usec();
+    if (GetUpdateRate() > 0 && m_lastSolveTicks > 0 && (now - m_lastSolveTicks) * GetUpdateRate() < 1e6)
+    {
+        return 0;
+    }
+    // without the update rate the divisor of the tier skips frames
+    if (m_updateRateHz <= 0 && m_lodRateDivisor > 1 && (m_lodFrame++ % m_lodRateDivisor) != 0)
+    {
+        return 0;
+    }
+    m_lastSolveTicks = now;
 
-    for (size_t i = 0; i < m_boneChains.size(); ++i)
+    // Calculate positions of all external targets. The target position is calculated in skeleton relative coordinates
+    // Godot objects are accessed only from the main thread, so targets are set before solving
+    Transform3D skeletonInverse = get_skeleton()->get_global_transform().affine_inverse();
+    if (m_warmStart && m_warmStartResetDistance > 0)
     {
-        ChainIKTarget* chain = Object::cast_to<ChainIKTarget>(m_boneChains[i]);
-        if (chain)
+        ReseedJumpedGroups(skeletonInverse);
+    }
+    ReseedGroups();
+
+    real_t thresholdSquared = m_skipThreshold * m_skipThreshold;
+    for (uint32_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
+    {
+        auto& group = m_groups[groupIndex];
+        bool moved = false;
+        for (auto& chain : group.chains)
         {
-            BuildTargetChain(*chain, i);
-            continue;
-        } 
-    
-        ChainIKBoneLink* link = Object::cast_to<ChainIKBoneLink>(m_boneChains[i]);
-        if (link)
+            if (chain.target)
+            {
+                Vector3 localPosition = skeletonInverse.xform(chain.target->get_global_transform().origin);
+                if (!group.steady || localPosition.distance_squared_to(chain.lastTarget) > thresholdSquared)
+                {
+                    chain.lastTarget = localPosition;
+                    chain.pos->SetPosition(ToLightIKVector(localPosition));
+                    moved = true;
+                }
+            }
+        }
+
+        // if nothing moved and the solver has already reached the steady state, the last solution is reused
+        if (moved || !group.steady)
+        {
+            m_pendingGroups.emplace_back(groupIndex);
+        }
+        else
         {
-            BuildLinkChain(*link, i);
-            continue;
+            ++m_skippedSolvesCount;
         }
+    }
+    m_solvesCount += m_pendingGroups.size();
 
-        UtilityFunctions::push_error("The ", i, "th chain is not set");
+    if (m_captureMode != CaptureDisabled)
+    {
+        CaptureFrame();
+    }
+    for (auto& group : m_groups)
+    {
+        group.reseeded = false;
     }
+    return (uint32_t)m_pendingGroups.size();
 }
 
-void LightIKPlugin::BuildTargetChain(ChainIKTarget& chain, uint32_t index)
+void LightIKPlugin::CaptureFrame()
 {
-    // reset chain dirty state
-    chain.IsDirty();
-    
-    // build chain of bones
-    int32_t chainTipBone    = get_skeleton()->find_bone(chain.GetTipBone());
-    int32_t chainStartBone  = get_skeleton()->find_bone(chain.GetRootBone());
-    
-    // if parameters are invalid, no need to build this chain
-    if (chain.GetTargetPath().is_empty() || chainTipBone < 0 || chainStartBone < 0 )
+    if (!m_definition)
     {
-        UtilityFunctions::push_error("The ", index, "th chain cannot be created, parameters are invalid");
         return;
     }
-    // attach target to the bone
-    Node3D* targetNode = get_node<Node3D>(chain.GetTargetPath());
-
-    auto target             = m_targets.emplace_back( NodeTarget{targetNode, &m_controllerIK->CreateTarget()});
-    auto rootChain          = BuildRootChain(chainTipBone, chain.GetLeafBoneLength());
 
-    m_controllerIK->CreateIKChain(rootChain, chainStartBone, 0, *target.pos);
-
-    if constexpr (settingEnableDebugging)
+    // The capture is valid for one definition. Rebuilds, changes of constraints and of chains disabled by the level of detail
+    // start a new capture: the file capture continues in the next numbered file, the ring buffer drops frames of the old definition
+    if (m_capture && m_captureVersion != m_definitionVersion)
     {
-        // Visualize chain information in both editor and player
-        AddChainLine(rootChain, chainStartBone, -1, m_controllerIK->GetSolversCount() - 1);
+        m_capture->Close();
+        m_capture = nullptr;
+        ++m_captureSection;
     }
-}
 
-void LightIKPlugin::BuildLinkChain(ChainIKBoneLink& link, uint32_t index)
-{
-    // reset link dirty state
-    link.IsDirty();
-
-    // find bones in the skeleton to build the link
-    int32_t chainTipBone    = get_skeleton()->find_bone(link.GetTipBone());
-    int32_t chainStartBone  = get_skeleton()->find_bone(link.GetRootBone());
-    int32_t chainTargetBone = get_skeleton()->find_bone(link.GetTargetBone());
+    if (!m_capture)
+    {
+        // groups of the capture are the groups solved by the plugin, so chains disabled by the level of detail are left out
+        RigDefinition definition = *m_definition;
+        definition.groups.clear();
+        for (const auto& group : m_groups)
+        {
+            definition.groups.emplace_back(group.definitionChains);
+        }
+        m_capture = std::make_unique<CaptureWriter>(definition, (uint32_t)m_captureRingFrames);
+        m_captureVersion = m_definitionVersion;
+        if (m_captureMode == CaptureFile && !m_capture->Open(GetCapturePath()))
+        {
+            m_capture = nullptr;
+            m_captureMode = CaptureDisabled;
+            return;
+        }
+    }
 
-    // if parameters are invalid, no need to build this chain
-    if (chainTargetBone < 0 || chainTipBone < 0 || chainStartBone < 0 )
+    // targets fed to the solver, in the order of chains of the captured groups
+    m_captureTargets.clear();
+    m_captureReseeded.clear();
+    for (uint32_t groupIndex = 0; groupIndex < m_groups.size(); ++groupIndex)
     {
-        UtilityFunctions::push_error("The ", index, " link cannot be created, parameters are invalid");
-        return;            
+        for (const auto& chain : m_groups[groupIndex].chains)
+        {
+            m_captureTargets.emplace_back(chain.lastTarget);
+        }
+        if (m_groups[groupIndex].reseeded)
+        {
+            m_captureReseeded.emplace_back(groupIndex);
+        }
     }
 
-    auto rootChain          = BuildRootChain(chainTipBone, link.GetLeafBoneLength());
-    auto targetChain        = BuildRootChain(chainTargetBone, 1.0);
+    // the pose is read before the solution of the frame is applied, so these are the input rotations
+    double time = Time::get_singleton()->get_ticks_usec() * 1e-6;
+    LightIKCapture::SolverSettings settings;
+    settings.iterations = (uint32_t)GetIterationsCount();
+    settings.tolerance  = m_tolerance;
+    settings.warmStart  = m_warmStart ? 1 : 0;
+    m_capture->AddFrame(time, settings, m_pendingGroups, m_captureReseeded, m_captureTargets, GetFrameGlobals().rotations);
+}
 
-    m_controllerIK->CreatePassiveChain(targetChain);
-    m_controllerIK->CreateIKLink(rootChain, chainStartBone, chainTargetBone);
-    
-    if constexpr (settingEnableDebugging)
+void LightIKPlugin::StopCapture()
+{
+    if (m_capture)
     {
-        // Visualize chain information in both editor and player
-        AddChainLine(rootChain, chainStartBone, chainTargetBone, m_controllerIK->GetSolversCount() - 1);
+        m_capture->Close();
+        m_capture = nullptr;
     }
+    m_captureSection = 0;
 }
 
-void LightIKPlugin::BuildConstraints()
+String LightIKPlugin::GetCapturePath() const
 {
-    for (size_t i = 0; i < m_constraintsArray.size(); ++i)
+    // the first definition is captured to the path as is, the following ones to capture_1.likc, capture_2.likc and so on
+    if (m_captureSection == 0)
     {
-        JointConstraints* constraintData = Object::cast_to<JointConstraints>(m_constraintsArray[i]);
-        if (constraintData)
-        {
-            const ConstraintData& data = constraintData->GetConstraintData();
-            LightIK::Constraints constraint {
-                (LightIK::ConstraintModes)data.rotationOrder,
-                (LightIK::ConstraintRotation)data.rotationDirection,
-                data.flexibility,
-                ToLightIKVector((2.0 * Math_PI) * data.angleMin / 360.0),
-                ToLightIKVector((2.0 * Math_PI) * data.angleMax / 360.0),
-            };
-            int32_t boneIndex = get_skeleton()->find_bone(data.boneName);
-            if (boneIndex >= 0)
-            {
-                m_controllerIK->SetConstraint(boneIndex, std::move(constraint));
-            }
-            else
-            {
-                UtilityFunctions::push_error("Constraint cannot be set. Bone ", data.boneName, " not found");    
-            }
-        }
+        return m_capturePath;
     }
+    String path = m_capturePath.get_basename() + "_" + String::num_int64(m_captureSection);
+    String extension = m_capturePath.get_extension();
+    return extension.is_empty() ? path : path + "." + extension;
 }
 
-std::vector<LightIK::BoneDesc> LightIKPlugin::BuildRootChain(int32_t tipBone, real_t leafBoneLength)
+bool LightIKPlugin::save_capture(const String& path) const
 {
-    assert(get_skeleton());
-    std::vector<LightIK::BoneDesc> rootChain;
+    if (!m_capture || m_captureMode != CaptureRingBuffer)
+    {
+        UtilityFunctions::push_warning("Ring buffer capture is not started, nothing to save");
+        return false;
+    }
+    return m_capture->Save(path);
+}
+
+void LightIKPlugin::SolvePending(uint32_t pendingCount)
+{
+    // Process all chains. Groups are independent so they can be solved simultaneously
+    if (m_parallelSolve && pendingCount > 1)
+    {
+        WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+        int64_t taskId = pool->add_group_task(callable_mp(this, &LightIKPlugin::SolveGroup), (int32_t)pendingCount, -1, true, "LightIK chains");
+        pool->wait_for_group_task_completion(taskId);
+    }
+    else
+    {
+        for (uint32_t index = 0; index < pendingCount; ++index)
+        {
+            SolveGroup(index);
+        }
+    }
+}
+
+void LightIKPlugin::_process(double delta)
+{
+    UpdateBuild();
+
+    // Update data of visual helpers
+    if constexpr (settingAllowRuntimeModification)
+    {
+        if (godot::Engine::get_singleton()->is_editor_hint())
+        {
+            UpdateSkeletonParameters();
+        }
+    }
+
+    if constexpr (settingEnableDebugging)
+    {
+        // update chains visual data if required
+        if (m_showHelpers && !m_simulate)
+        {
+            assert(get_skeleton());
+            UpdateVisualData();
+        }
+    }
+}
+
+void LightIKPlugin::BuildChains()
+{
+    // full rebuild drops all built chains together with the state of their controllers
+    UpdateTopology();
+    BuildRequest request = MakeBuildRequest(true, {});
+    CompileDefinition(request);
+    ApplyBuild(request);
+}
+
+void LightIKPlugin::RebuildChains(const std::unordered_set<uint64_t>& dirtyChains)
+{
+    BuildRequest request = MakeBuildRequest(false, dirtyChains);
+    CompileDefinition(request);
+    ApplyBuild(request);
+}
+
+LightIKPlugin::BuildRequest LightIKPlugin::MakeBuildRequest(bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains)
+{
+    BuildRequest request;
+    request.generation  = ++m_buildGeneration;
+    request.fullBuild   = fullBuild;
+    request.topology    = m_topology;
+    request.dirtyChains = dirtyChains;
+    request.rigBuild    = m_rig.is_valid();
+
+    if (request.rigBuild)
+    {
+        // the rig can be already compiled by another instance of the skeleton type, otherwise it is compiled as a whole
+        request.definition = m_rig->FindDefinition(*m_topology);
+        if (!request.definition)
+        {
+            request.sources     = m_rig->GetSources();
+            request.compiledRig = m_rig->GetCompiledDefinition(*m_topology);
+        }
+        return request;
+    }
+
+    // parameters of resources are copied here, the compilation reads only the copy
+    request.previous    = fullBuild ? nullptr : m_definition;
+    request.sources     = RigSources::Read(m_boneChains, m_constraintsArray);
+    request.compiledRig = m_compiledRig;
+    return request;
+}
+
+void LightIKPlugin::CompileDefinition(BuildRequest& request)
+{
+    // Called from the worker thread, so only the data of the request can be accessed here
+    if (request.definition)
+    {
+        return;
+    }
+
+    // the full build takes the compiled definition if the skeleton and the sources have not changed since it was compiled
+    uint64_t sourceHash = RigCache::GetSourceHash(request.sources);
+    if (!request.previous)
+    {
+        request.definition  = RigCache::Deserialize(request.compiledRig, request.topology->GetHash(), request.topology->GetRestHash(), sourceHash, request.sources);
+        request.fromCache   = (bool)request.definition;
+    }
+
+    // Collect all chains from the skeleton, chains that were not changed are taken from the previous build
+    if (!request.definition)
+    {
+        RigBuilder builder(request.topology);
+        request.definition  = builder.Build(request.sources, request.previous.get(), request.dirtyChains);
+        request.compiledRig = RigCache::Serialize(*request.definition, sourceHash);
+    }
+}
+
+void LightIKPlugin::ApplyBuild(const BuildRequest& request)
+{
+    std::shared_ptr<const RigDefinition> definition = request.definition;
+    if (request.rigBuild && definition != m_rig->FindDefinition(*request.topology))
+    {
+        // The definition compiled by another instance of the skeleton type in the meantime is taken instead.
+        // If the rig was edited during the compilation, the result is outdated and the rig is compiled again
+        definition = m_rig->AddDefinition(definition, request.sources, request.fromCache ? PackedByteArray() : request.compiledRig);
+        if (!definition)
+        {
+            RequestBuild(true);
+            return;
+        }
+    }
+    else if (!request.rigBuild)
+    {
+        // only resources that were not edited during the compilation are up to date
+        request.sources.ResetDirtyState(m_boneChains, m_constraintsArray, !request.previous, request.dirtyChains);
+        m_compiledRig = request.compiledRig;
+    }
+
+    if (request.fullBuild)
+    {
+        m_definition = nullptr;
+        m_groups.clear();
+        get_skeleton()->clear_bones_global_pose_override();
+    }
+    ApplyDefinition(std::move(definition), request.dirtyChains);
+}
+
+void LightIKPlugin::RequestBuild(bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains)
+{
+    m_buildRequested    = true;
+    m_buildRequestFull  = m_buildRequestFull || fullBuild;
+    m_buildDirtyChains.insert(dirtyChains.begin(), dirtyChains.end());
+}
+
+void LightIKPlugin::UpdateBuild()
+{
+    WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+    if (m_buildTaskId >= 0)
+    {
+        // the previous controllers keep working until the new definition is ready
+        if (!pool->is_task_completed(m_buildTaskId))
+        {
+            return;
+        }
+        pool->wait_for_task_completion(m_buildTaskId);
+        m_buildTaskId = -1;
+
+        std::unique_ptr<BuildRequest> request = std::move(m_pendingBuild);
+        if (request->generation == m_buildGeneration)
+        {
+            ApplyBuild(*request);
+        }
+        else
+        {
+            // the definition was rebuilt synchronously in the meantime, so the request is compiled again from the actual state
+            RequestBuild(request->fullBuild, request->dirtyChains);
+        }
+    }
+
+    if (!m_buildRequested || !is_node_ready() || !get_skeleton())
+    {
+        return;
+    }
+
+    // the change of bones of the skeleton invalidates all chains
+    bool fullBuild = UpdateTopology() || m_buildRequestFull;
+    m_buildRequested    = false;
+    m_buildRequestFull  = false;
+
+    m_pendingBuild = std::make_unique<BuildRequest>(MakeBuildRequest(fullBuild, m_buildDirtyChains));
+    m_buildDirtyChains.clear();
+    if (m_pendingBuild->definition)
+    {
+        ApplyBuild(*m_pendingBuild);
+        m_pendingBuild = nullptr;
+        return;
+    }
+    m_buildTaskId = pool->add_task(callable_mp(this, &LightIKPlugin::CompilePendingBuild), false, "LightIK build");
+}
+
+void LightIKPlugin::CompilePendingBuild()
+{
+    CompileDefinition(*m_pendingBuild);
+}
+
+void LightIKPlugin::WaitBuild()
+{
+    if (m_buildTaskId >= 0)
+    {
+        WorkerThreadPool::get_singleton()->wait_for_task_completion(m_buildTaskId);
+        m_buildTaskId = -1;
+        m_pendingBuild = nullptr;
+    }
+}
+
+void LightIKPlugin::ApplyDefinition(std::shared_ptr<const RigDefinition> definition, const std::unordered_set<uint64_t>& dirtyChains)
+{
+    std::vector<SolverGroup> previousGroups = std::move(m_groups);
+    m_definition = std::move(definition);
+    m_groups.clear();
+
+    // Chains disabled by the level of detail are left to the animation. A part of an independent group is independent too
+    std::vector<std::vector<size_t>> activeGroups;
+    for (const auto& groupChains : m_definition->groups)
+    {
+        std::vector<size_t> activeChains;
+        std::copy_if(groupChains.begin(), groupChains.end(), std::back_inserter(activeChains), 
+            [this](size_t c) { return !m_lodDisabledChains.count(m_definition->chains[c].chainIndex); });
+        if (!activeChains.empty())
+        {
+            activeGroups.emplace_back(std::move(activeChains));
+        }
+    }
+
+    // The solver reads the pose only of bones of the active chains, root chains include all ancestors of their bones
+    std::vector<int32_t> poseBones;
+    for (const auto& groupChains : activeGroups)
+    {
+        for (size_t c : groupChains)
+        {
+            for (const auto* boneChain : {&m_definition->chains[c].rootChain, &m_definition->chains[c].targetChain})
+            {
+                for (const LightIK::BoneDesc& bone : *boneChain)
+                {
+                    poseBones.emplace_back(bone.boneIndex);
+                }
+            }
+        }
+    }
+    std::sort(poseBones.begin(), poseBones.end());
+    poseBones.erase(std::unique(poseBones.begin(), poseBones.end()), poseBones.end());
+    if (poseBones != m_framePoseBones)
+    {
+        m_framePoseBones = std::move(poseBones);
+        m_framePoseFrame = UINT64_MAX;
+    }
+
+    // Each group of chains gets its own controller. Groups that consist of the same unchanged chains keep their controllers
+    for (const auto& groupChains : activeGroups)
+    {
+        auto existing = std::find_if(previousGroups.begin(), previousGroups.end(), [&](const SolverGroup& group) { return IsSameGroup(group, groupChains, dirtyChains); });
+        if (existing != previousGroups.end())
+        {
+            for (size_t c = 0; c < groupChains.size(); ++c)
+            {
+                existing->chains[c].chainIndex = m_definition->chains[groupChains[c]].chainIndex;
+            }
+            existing->definitionChains = groupChains;
+            m_groups.emplace_back(std::move(*existing));
+            previousGroups.erase(existing);
+        }
+        else
+        {
+            m_groups.emplace_back(BuildGroup(groupChains, GetFramePose()));
+        }
+    }
+
+    if constexpr (settingEnableDebugging)
+    {
+        // Visualize chain information in both editor and player
+        m_debugChains.clear();
+        for (size_t groupId = 0; groupId < m_groups.size(); ++groupId)
+        {
+            const auto& groupChains = activeGroups[groupId];
+            for (size_t c = 0; c < groupChains.size(); ++c)
+            {
+                const ChainDefinition& chain = m_definition->chains[groupChains[c]];
+                AddChainLine(chain.rootChain, chain.startBone, chain.targetBone, groupId, m_groups[groupId].chains[c].solverId);
+            }
+        }
+    }
+    ++m_definitionVersion;
+}
+
+bool LightIKPlugin::IsSameGroup(const SolverGroup& group, const std::vector<size_t>& groupChains, const std::unordered_set<uint64_t>& dirtyChains) const
+{
+    if (group.chains.size() != groupChains.size())
+    {
+        return false;
+    }
+
+    for (size_t c = 0; c < groupChains.size(); ++c)
+    {
+        const ChainDefinition& chain = m_definition->chains[groupChains[c]];
+        if (chain.rebuilt || dirtyChains.count(chain.chainId) || chain.chainId != group.chains[c].chainId)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+LightIKPlugin::SolverGroup LightIKPlugin::BuildGroup(const std::vector<size_t>& groupChains, const SkeletonPose& pose) const
+{
+    SolverGroup group;
+    group.definitionChains = groupChains;
+
+    for (size_t c : groupChains)
+    {
+        const ChainDefinition& chain = m_definition->chains[c];
+        ChainSolver solver {chain.chainId, chain.chainIndex};
+        if (!chain.targetPath.is_empty())
+        {
+            // targets are resolved for every instance, the definition can be shared by different plugins
+            solver.target   = get_node<Node3D>(chain.targetPath);
+            if (!solver.target)
+            {
+                UtilityFunctions::push_error("The ", chain.chainIndex, "th chain target not found");
+            }
+        }
+        group.chains.emplace_back(solver);
+
+        for (const auto* boneChain : {&chain.rootChain, &chain.targetChain})
+        {
+            for (const LightIK::BoneDesc& bone : *boneChain)
+            {
+                group.bones.emplace_back(bone.boneIndex);
+            }
+        }
+    }
+
+    std::sort(group.bones.begin(), group.bones.end());
+    group.bones.erase(std::unique(group.bones.begin(), group.bones.end()), group.bones.end());
+
+    // the definition is compiled from the rest pose, every instance starts from its own pose
+    CreateController(group, &pose);
+    group.reseeded = true;
+    return group;
+}
+
+int32_t LightIKPlugin::GetGroupBone(const SolverGroup& group, int32_t boneIndex)
+{
+    auto bone = std::lower_bound(group.bones.begin(), group.bones.end(), boneIndex);
+    return (bone != group.bones.end() && *bone == boneIndex) ? (int32_t)(bone - group.bones.begin()) : -1;
+}
+
+void LightIKPlugin::CreateController(SolverGroup& group, const SkeletonPose* pose) const
+{
+    // The definition is not changed, the controller is created from copies of its bones renumbered to the bones of the group,
+    // so the controller of a limb doesn't allocate the state of the whole skeleton. The order of bones is kept by the renumbering
+    auto remap = [&group, pose](const std::vector<LightIK::BoneDesc>& bones)
+    {
+        std::vector<LightIK::BoneDesc> remapped = bones;
+        for (LightIK::BoneDesc& bone : remapped)
+        {
+            if (pose)
+            {
+                bone.rotation = ToLightIKQuaternion(pose->rotations[bone.boneIndex]);
+            }
+            bone.boneIndex = GetGroupBone(group, bone.boneIndex);
+        }
+        return remapped;
+    };
+
+    group.controller = std::make_unique<LightIK::LightIK>(group.bones.size());
+    for (size_t c = 0; c < group.definitionChains.size(); ++c)
+    {
+        const ChainDefinition& chain = m_definition->chains[group.definitionChains[c]];
+        ChainSolver& solver = group.chains[c];
+        if (!chain.targetPath.is_empty())
+        {
+            solver.pos = &group.controller->CreateTarget();
+            group.controller->CreateIKChain(remap(chain.rootChain), GetGroupBone(group, chain.startBone), 0, *solver.pos);
+        }
+        else
+        {
+            group.controller->CreatePassiveChain(remap(chain.targetChain));
+            group.controller->CreateIKLink(remap(chain.rootChain), GetGroupBone(group, chain.startBone), GetGroupBone(group, chain.targetBone));
+        }
+        solver.solverId = group.controller->GetSolversCount() - 1;
+    }
+    ApplyConstraints(group);
+}
+
+void LightIKPlugin::SolveGroup(uint32_t taskIndex)
+{
+    // Called from the worker threads, so only the controller of the group can be accessed here
+    SolverGroup& group = m_groups[m_pendingGroups[taskIndex]];
+    auto solveStart = std::chrono::steady_clock::now();
+    uint64_t allocationsBefore = GetThreadAllocationsCount();
+    if (!m_warmStart)
+    {
+        group.controller->ResetPose();
+    }
 
-    // Build the root chain 
-    Vector3 parentPosition = get_skeleton()->get_bone_global_pose(tipBone).origin;
+    for (auto& chain : group.chains)
+    {
+        chain.iterations    = 0;
+        chain.converged     = false;
+    }
 
-    auto children = get_skeleton()->get_bone_children(tipBone);
-    if (children.size())
+    // residuals stay in the solver precision until the solve is done
+    LightIK::real toleranceSquared = (LightIK::real)m_tolerance * (LightIK::real)m_tolerance;
+    int iterationsCount = GetIterationsCount();
+    if (m_tolerance > 0)
     {
-        // If child available calculate the length of the tip bone using its real parameters
-        parentPosition = get_skeleton()->get_bone_global_pose(children[0]).origin;
+        // Solve iteration by iteration and stop as soon as all chains of the group reached their targets
+        int iterations = 0;
+        bool converged = false;
+        while (!converged && iterations < iterationsCount)
+        {
+            group.controller->Update(1);
+            converged = UpdateResiduals(group, ++iterations, toleranceSquared);
+        }
+        group.stats.iterations = iterations;
     }
     else
     {
-        // If tip bone is the leaf bone, consider the length of the bone is 1
-        LightIK::Quaternion rotation = ToLightIKQuaternion(get_skeleton()->get_bone_pose_rotation(tipBone));
-        rootChain.emplace_back(LightIK::BoneDesc{rotation, leafBoneLength, tipBone});
-        tipBone = get_skeleton()->get_bone_parent(tipBone);
+        group.controller->Update(iterationsCount);
+        UpdateResiduals(group, iterationsCount, toleranceSquared);
+        group.stats.iterations = iterationsCount;
     }
+    group.stats.allocations = GetThreadAllocationsCount() - allocationsBefore;
+
+    // Collect rotations of the bones the solver produced, to avoid scanning the whole skeleton on write-back
+    group.previousSolution.swap(group.solution);
+    group.solution.clear();
+    // the controller knows bones by their indices in the group
+    const auto& deltas = group.controller->GetDeltaRotations();
+    for (size_t bone = 0; bone < group.bones.size(); ++bone)
+    {
+        if (deltas[bone])
+        {
+            group.solution.emplace_back(BoneRotation{group.bones[bone], FromLightIKQuaternion(*deltas[bone])});
+        }
+    }
+
+    // the solver reached the steady state if another iteration doesn't change the solution
+    group.steady = std::equal(group.solution.begin(), group.solution.end(), group.previousSolution.begin(), group.previousSolution.end(), 
+        [](const BoneRotation& current, const BoneRotation& previous)
+        {
+            return current.boneIndex == previous.boneIndex && !IsRotationChanged(previous.rotation, current.rotation);
+        });
 
-    while(tipBone >= 0)
+    group.stats.chainsSolved = (int)group.chains.size();
+    group.stats.cappedChains = 0;
+    group.stats.residualSum  = 0;
+    for (auto& chain : group.chains)
     {
-        // Collect local rotation of the bone
-        LightIK::Quaternion rotation = ToLightIKQuaternion(get_skeleton()->get_bone_pose_rotation(tipBone));
-        
-        // Calculate the length of the bone by using position of current and previous joint
-        Vector3 currentPosition = get_skeleton()->get_bone_global_pose(tipBone).origin;
-        real_t length = (currentPosition - parentPosition).length();
+        chain.residual           = (real_t)std::sqrt(chain.residualSquared);
+        group.stats.cappedChains += (m_tolerance > 0 && !chain.converged) ? 1 : 0;
+        group.stats.residualSum  += chain.residual;
+    }
+    group.stats.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+}
 
-        // Add bone to the root chain
-        rootChain.emplace_back(LightIK::BoneDesc{rotation, length, tipBone});
+void LightIKPlugin::CollectStats()
+{
+    // only groups solved in this frame contribute to the statistics of the frame
+    m_frameStats = SolveStats{};
+    for (uint32_t groupIndex : m_pendingGroups)
+    {
+        const SolveStats& stats = m_groups[groupIndex].stats;
+        m_frameStats.timeMs         += stats.timeMs;
+        m_frameStats.chainsSolved   += stats.chainsSolved;
+        m_frameStats.iterations     += stats.iterations;
+        m_frameStats.cappedChains   += stats.cappedChains;
+        m_frameStats.residualSum    += stats.residualSum;
+        m_frameStats.allocations    += stats.allocations;
+    }
+}
+
+Dictionary LightIKPlugin::get_solve_stats() const
+{
+    return MakeStatsDictionary(m_frameStats);
+}
+
+Dictionary LightIKPlugin::MakeStatsDictionary(const SolveStats& stats)
+{
+    Dictionary result;
+    result["time_ms"]           = stats.timeMs;
+    result["chains_solved"]     = stats.chainsSolved;
+    result["iterations"]        = stats.iterations;
+    result["capped_chains"]     = stats.cappedChains;
+    result["average_residual"]  = stats.chainsSolved > 0 ? stats.residualSum / stats.chainsSolved : 0.0;
+    result["allocations"]       = (int64_t)stats.allocations;
+    return result;
+}
 
-        // Proceed to the next bone
-        parentPosition = currentPosition;
-        tipBone = get_skeleton()->get_bone_parent(tipBone);
+void LightIKPlugin::ReseedJumpedGroups(const Transform3D& skeletonInverse)
+{
+    // The solution of the previous frame is useless as a starting point if the target jumped too far.
+    // Such groups are reseeded from the current pose of the skeleton, so the solve starts from the incoming animation
+    real_t distanceSquared = m_warmStartResetDistance * m_warmStartResetDistance;
+    for (auto& group : m_groups)
+    {
+        bool jumped = false;
+        for (const auto& chain : group.chains)
+        {
+            if (chain.target && !group.solution.empty())
+            {
+                Vector3 localPosition = skeletonInverse.xform(chain.target->get_global_transform().origin);
+                jumped = jumped || localPosition.distance_squared_to(chain.lastTarget) > distanceSquared;
+            }
+        }
+
+        group.reseed = group.reseed || jumped;
     }
-    // the array is filled from tip to root, to work properly with arrays, need to reverse them
-    // TODO: REALLY?
-    std::reverse(rootChain.begin(), rootChain.end());
-    return rootChain;
+}
+
+void LightIKPlugin::ReseedGroups()
+{
+    // The controller is created again from the chains of the definition with rotations of the current pose.
+    // The definition stays the same, it can be shared with other plugins or loaded from the compiled cache
+    for (auto& group : m_groups)
+    {
+        if (group.reseed)
+        {
+            CreateController(group, &GetFramePose());
+            group.reseed = false;
+            group.reseeded = true;
+        }
+    }
+}
+
+void LightIKPlugin::UpdateLod()
+{
+    Camera3D* camera = get_viewport() ? get_viewport()->get_camera_3d() : nullptr;
+    if (!camera || (m_lodTiers.is_empty() && !m_lodSuspendOffscreen))
+    {
+        ApplyLodTier(-1);
+        if (m_lodSuspended)
+        {
+            ResumeGroups();
+        }
+        return;
+    }
+
+    // Tiers are ordered by distance, the last tier is used beyond the distance of all tiers
+    real_t distance = camera->get_global_transform().origin.distance_to(get_skeleton()->get_global_transform().origin);
+    int tierIndex = (int)m_lodTiers.size() - 1;
+    for (int i = 0; i < (int)m_lodTiers.size(); ++i)
+    {
+        LightIKLodTier* tier = Object::cast_to<LightIKLodTier>(m_lodTiers[i]);
+        if (tier && distance <= tier->GetDistance())
+        {
+            tierIndex = i;
+            break;
+        }
+    }
+    ApplyLodTier(tierIndex);
+
+    bool suspended = m_lodSuspendOffscreen && !IsVisible(*camera);
+    if (m_lodSuspended && !suspended)
+    {
+        ResumeGroups();
+    }
+    m_lodSuspended = suspended;
+}
+
+void LightIKPlugin::ResumeGroups()
+{
+    // Groups are kept while the plugin is suspended, but the state of their controllers is too old 
+    // to be used as a starting point, so they are reseeded from the current pose and solved again
+    for (auto& group : m_groups)
+    {
+        group.reseed = true;
+    }
+    m_lodSuspended = false;
+    m_lastSolveTicks = 0;
+}
+
+void LightIKPlugin::ApplyLodTier(int tierIndex)
+{
+    if (tierIndex == m_lodTier)
+    {
+        return;
+    }
+    m_lodTier = tierIndex;
+
+    LightIKLodTier* tier = tierIndex >= 0 ? Object::cast_to<LightIKLodTier>(m_lodTiers[tierIndex]) : nullptr;
+    m_lodIterations     = tier ? tier->GetIterationsCount() : 0;
+    m_lodRateDivisor    = tier ? tier->GetUpdateRateDivisor() : 1;
+    InvalidateSolution();
+
+    // groups are rebuilt only if the set of disabled chains has changed
+    std::unordered_set<uint32_t> disabledChains;
+    if (tier)
+    {
+        const PackedInt32Array& chains = tier->GetDisabledChains();
+        disabledChains.insert(chains.ptr(), chains.ptr() + chains.size());
+    }
+    if (disabledChains != m_lodDisabledChains)
+    {
+        m_lodDisabledChains = std::move(disabledChains);
+        if (m_definition)
+        {
+            ApplyDefinition(m_definition, {});
+        }
+    }
+}
+
+bool LightIKPlugin::IsVisible(const Camera3D& camera) const
+{
+    // the skeleton is approximated by the sphere around its origin, frustum planes look outside
+    Vector3 center = get_skeleton()->get_global_transform().origin;
+    TypedArray<Plane> frustum = camera.get_frustum();
+    for (int64_t i = 0; i < frustum.size(); ++i)
+    {
+        Plane plane = frustum[i];
+        if (plane.distance_to(center) > m_lodVisibilityRadius)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int LightIKPlugin::GetIterationsCount() const
+{
+    return m_lodIterations > 0 ? m_lodIterations : m_iterationsCount;
+}
+
+real_t LightIKPlugin::GetUpdateRate() const
+{
+    return m_updateRateHz / m_lodRateDivisor;
+}
+
+void LightIKPlugin::InvalidateSolution()
+{
+    // parameters of the solver were changed, all groups have to be solved again
+    for (auto& group : m_groups)
+    {
+        group.steady = false;
+    }
+}
+
+bool LightIKPlugin::UpdateResiduals(SolverGroup& group, int iterations, LightIK::real toleranceSquared) const
+{
+    bool converged = true;
+    for (auto& chain : group.chains)
+    {
+        // called after every iteration in tolerance mode, so positions are not converted to Godot types
+        chain.residualSquared   = GetDistanceSquared(group.controller->GetTipPosition(chain.solverId), group.controller->GetTargetPosition(chain.solverId));
+        bool reached            = chain.residualSquared <= toleranceSquared;
+        converged               = converged && reached;
+
+        // the group iterates until its last chain converges, chains that converged earlier keep their iteration
+        if (!chain.converged)
+        {
+            chain.iterations    = iterations;
+            chain.converged     = m_tolerance > 0 && reached;
+        }
+    }
+    return converged;
+}
+
+const LightIKPlugin::ChainSolver* LightIKPlugin::FindChainSolver(int chainIndex) const
+{
+    for (const auto& group : m_groups)
+    {
+        for (const auto& chain : group.chains)
+        {
+            if ((int)chain.chainIndex == chainIndex)
+            {
+                return &chain;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void LightIKPlugin::ApplySolution(real_t weight)
+{
+    // Update rotations of the bones. Groups are processed in the fixed order to keep the result deterministic.
+    // Every write invalidates the global pose of the skeleton, so only bones which rotation really differs are updated
+    // the pose is read only if there is something to write
+    if (std::all_of(m_groups.begin(), m_groups.end(), [](const SolverGroup& group) { return group.solution.empty(); }))
+    {
+        return;
+    }
+    GetFramePose();
+
+    Skeleton3D* skeleton = get_skeleton();
+    for (const auto& group : m_groups)
+    {
+        // both solutions are sorted by the bone index
+        auto previous = group.previousSolution.begin();
+        for (const BoneRotation& bone : group.solution)
+        {
+            Quaternion rotation = bone.rotation;
+            if (weight < 1)
+            {
+                while (previous != group.previousSolution.end() && previous->boneIndex < bone.boneIndex)
+                {
+                    ++previous;
+                }
+                if (previous != group.previousSolution.end() && previous->boneIndex == bone.boneIndex)
+                {
+                    rotation = previous->rotation.slerp(bone.rotation, weight);
+                }
+            }
+
+            // groups of the outdated definition are kept until the pending build is applied
+            if (bone.boneIndex >= (int32_t)m_framePose.rotations.size())
+            {
+                continue;
+            }
+
+            // the snapshot follows the writes, so helpers see the pose with the solution applied
+            const Quaternion& current = m_framePose.rotations[bone.boneIndex];
+            if (IsRotationChanged(current, rotation))
+            {
+                skeleton->set_bone_pose_rotation(bone.boneIndex, rotation);
+                m_framePose.SetRotation(bone.boneIndex, rotation);
+                m_framePoseDirty = true;
+            }
+        }
+    }
+}
+
+void LightIKPlugin::BuildConstraints()
+{
+    if (m_rig.is_valid() || !m_definition)
+    {
+        // constraints of the rig are compiled together with its chains
+        return;
+    }
+
+    RigBuilder builder(m_topology);
+    RigSources sources = RigSources::Read(m_boneChains, m_constraintsArray);
+    m_definition = builder.BuildConstraints(*m_definition, sources.constraints);
+    m_compiledRig = RigCache::Serialize(*m_definition, RigCache::GetSourceHash(sources));
+    for (auto& group : m_groups)
+    {
+        ApplyConstraints(group);
+    }
+    ++m_definitionVersion;
+}
+
+void LightIKPlugin::ApplyConstraints(SolverGroup& group) const
+{
+    group.steady = false;
+
+    // only controllers that process the bone need the constraint, the lookup replaces the search through all constraints
+    for (size_t bone = 0; bone < group.bones.size(); ++bone)
+    {
+        int32_t constraint = m_definition->boneConstraints[group.bones[bone]];
+        if (constraint >= 0)
+        {
+            group.controller->SetConstraint((int32_t)bone, LightIK::Constraints(m_definition->constraints[constraint].constraint));
+        }
+    }
+}
+
+void LightIKPlugin::UpdateVisualData()
+{
+    // Visual data depends on the pose of the skeleton, the definition of chains and constraints and the state of controllers.
+    // All counters only grow, so their sum changes whenever any of them changes
+    uint64_t version = m_poseVersion + m_definitionVersion + m_solvesCount;
+    if (version == m_visualVersion)
+    {
+        return;
+    }
+    m_visualVersion = version;
+
+    UpdateChainsVisualData();
+    UpdateConstraintsVisualData();
 }
 
 void LightIKPlugin::UpdateChainsVisualData()
 {
     // Provide the list of transforms that represents bones in a single chain
     m_helper->ResetChainData();
+    const SkeletonPose& pose = GetFrameGlobals();
     VisualHelper::ChainVisualData chainData;
     for (const auto& chain : m_debugChains)
     {
         chainData.chain.clear();
         for (int32_t boneId : chain.indices)
         {
-            chainData.chain.emplace_back(get_skeleton()->get_bone_global_pose(boneId));
+            chainData.chain.emplace_back(pose.globals[boneId]);
         }
-        chainData.chain.emplace_back(Transform3D(chainData.chain.back().basis, FromLightIKVector(m_controllerIK->GetTipPosition(chain.chainId))));
+        const auto& controller = m_groups[chain.groupId].controller;
+        chainData.chain.emplace_back(Transform3D(chainData.chain.back().basis, FromLightIKVector(controller->GetTipPosition(chain.chainId))));
         
-        chainData.start     = get_skeleton()->get_bone_global_pose(chain.startIndex);
+        chainData.start     = pose.globals[chain.startIndex];
 
-        chainData.target    = FromLightIKVector(m_controllerIK->GetTargetPosition(chain.chainId));
+        chainData.target    = FromLightIKVector(controller->GetTargetPosition(chain.chainId));
         m_helper->AddChain(chainData);
     }
 }
@@ -452,28 +1570,30 @@ void LightIKPlugin::UpdateConstraintsVisualData()
 {
     // Provide information about bone constraints
     m_helper->ResetBoneConstraintsData();
-    for (size_t i = 0; i < m_constraintsArray.size(); ++i)
+    const SkeletonPose& pose = GetFrameGlobals();
+    TypedArray<JointConstraints> constraintsArray = GetConstraintsArray();
+    for (size_t i = 0; i < constraintsArray.size(); ++i)
     {
-        JointConstraints* constraintData = Object::cast_to<JointConstraints>(m_constraintsArray[i]);
+        JointConstraints* constraintData = Object::cast_to<JointConstraints>(constraintsArray[i]);
         
         if (constraintData) 
         {
             const auto& data = constraintData->GetConstraintData();
-            int32_t index = get_skeleton()->find_bone(data.boneName);
+            int32_t index = m_topology->FindBone(data.boneName);
             if (index < 0)
             {
                 continue;
             }
             Basis localBasis;
-            int32_t parent = get_skeleton()->get_bone_parent(index);
-            Quaternion localRotation = get_skeleton()->get_bone_pose_rotation(index);
-            Transform3D bonePosition = get_skeleton()->get_bone_global_pose(index);
+            int32_t parent = m_topology->GetParent(index);
+            Quaternion localRotation = pose.rotations[index];
+            Transform3D bonePosition = pose.globals[index];
             if (parent >= 0)
             {
-                localBasis = get_skeleton()->get_bone_global_pose(parent).basis;
+                localBasis = pose.globals[parent].basis;
 
                 //TODO: dirty workaround, looks like basis of the first bone w/o parent is calculated incorrectly (based on rotation of the skeleton)
-                if (get_skeleton()->get_bone_parent(parent) < 0)
+                if (m_topology->GetParent(parent) < 0)
                 {
                     localBasis = Basis() * localRotation;
                 }
@@ -490,19 +1610,57 @@ void LightIKPlugin::UpdateConstraintsVisualData()
     }
 }
 
+bool LightIKPlugin::UpdateTopology()
+{
+    // the topology is shared with chains and constraints of the same skeleton, and is rebuilt once the skeleton changes
+    auto topology = SkeletonTopology::Get(get_skeleton());
+    bool changed = (topology != m_topology);
+    m_topology = std::move(topology);
+    return changed;
+}
+
 void LightIKPlugin::UpdateSkeletonParameters()
 {
-    bool chainsUpdated = false;
-    for (size_t c = 0; c < m_boneChains.size(); ++c)
+    // the requested build takes all changes into account
+    if (m_buildRequested || m_buildTaskId >= 0)
     {
-        BoneChain* chain = Object::cast_to<BoneChain>(m_boneChains[c]);
-        chainsUpdated = chainsUpdated || (chain && chain->IsDirty());
+        return;
     }
 
-    if (chainsUpdated)
+    if (m_rig.is_valid())
+    {
+        // edits of the rig invalidate its compiled definition, every plugin that uses the rig picks up the new one
+        m_rig->UpdateDirtyState();
+        if (UpdateTopology() || m_rig->FindDefinition(*m_topology) != m_definition)
+        {
+            RequestBuild(true);
+        }
+        return;
+    }
+
+    // bones of the skeleton had been changed, all chains have to be rebuilt
+    if (UpdateTopology())
     {
         BuildChains();
     }
+    else
+    {
+        // only changed chains are rebuilt, the rest of the chains keep their state
+        std::unordered_set<uint64_t> dirtyChains;
+        for (size_t c = 0; c < m_boneChains.size(); ++c)
+        {
+            BoneChain* chain = Object::cast_to<BoneChain>(m_boneChains[c]);
+            if (chain && chain->IsDirty())
+            {
+                dirtyChains.insert(chain->get_instance_id());
+            }
+        }
+
+        if (!dirtyChains.empty())
+        {
+            RebuildChains(dirtyChains);
+        }
+    }
 
     bool constraintsUpdated = false;
     for (size_t c = 0; c < m_constraintsArray.size(); ++c)
@@ -518,7 +1676,7 @@ void LightIKPlugin::UpdateSkeletonParameters()
     }
 }
 
-void LightIKPlugin::AddChainLine(std::vector<LightIK::BoneDesc> chain, int32_t startIndex, int32_t targetIndex, size_t chainId)
+void LightIKPlugin::AddChainLine(const std::vector<LightIK::BoneDesc>& chain, int32_t startIndex, int32_t targetIndex, size_t groupId, size_t chainId)
 {
     auto& newDebugChain = m_debugChains.emplace_back();
     for (const LightIK::BoneDesc& bone : chain)
@@ -527,6 +1685,7 @@ void LightIKPlugin::AddChainLine(std::vector<LightIK::BoneDesc> chain, int32_t s
     }
     newDebugChain.startIndex    = startIndex;
     newDebugChain.targetIndex   = targetIndex;
+    newDebugChain.groupId       = groupId;
     newDebugChain.chainId       = chainId;
 
     assert(newDebugChain.indices.size());
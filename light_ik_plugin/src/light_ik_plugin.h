@@ -4,33 +4,59 @@
 
 #include "light_ik/light_ik.h"
 #include "bone_chain.h"
+#include "light_ik_rig.h"
+#include "light_ik_lod.h"
+#include "rig_definition.h"
 
 #include <godot_cpp/classes/skeleton_modifier3d.hpp>
 #include <godot_cpp/classes/resource.hpp>
 #include <godot_cpp/variant/node_path.hpp>
 
-#include <list>
+#include <vector>
+#include <unordered_set>
 
 namespace godot
 {
 constexpr bool settingEnableDebugging = true;
 constexpr bool settingAllowRuntimeModification = true;
+// rotations that differ from the current pose by the smaller angle in radians are not written to the skeleton
+constexpr real_t settingRotationEpsilon = (real_t)1e-5;
 
 class VisualHelper;
+class Camera3D;
+class SkeletonTopology;
+class CaptureWriter;
 
 class LightIKPlugin : public SkeletonModifier3D
 {
     GDCLASS(LightIKPlugin, SkeletonModifier3D)
 
     DEFINE_PROPERTY(int,    iterations_count);
+    DEFINE_PROPERTY(float,  tolerance);
+    DEFINE_PROPERTY(float,  skip_threshold);
+    DEFINE_PROPERTY(bool,   warm_start);
+    DEFINE_PROPERTY(float,  warm_start_reset_distance);
+    DEFINE_PROPERTY(float,  update_rate_hz);
     DEFINE_PROPERTY(bool,   simulate);
+    DEFINE_PROPERTY(bool,   parallel_solve);
+    DEFINE_PROPERTY(bool,   batch_solve);
 
     DEFINE_PROPERTY(bool,   show_helpers);
     DEFINE_PROPERTY(float,  marker_radius);
     DEFINE_PROPERTY(float,  constraint_radius);
 
+    DEFINE_PROPERTY(TypedArray<LightIKLodTier>, lod_tiers);
+    DEFINE_PROPERTY(bool,   lod_suspend_offscreen);
+    DEFINE_PROPERTY(float,  lod_visibility_radius);
+
+    DEFINE_PROPERTY(int,    capture_mode);
+    DEFINE_PROPERTY(String, capture_path);
+    DEFINE_PROPERTY(int,    capture_ring_frames);
+
+    DEFINE_PROPERTY(Ref<LightIKRig>, rig);
     DEFINE_PROPERTY(TypedArray<BoneChain>, bone_chains);
     DEFINE_PROPERTY(TypedArray<JointConstraints>, constraints_array);
+    DEFINE_PROPERTY(PackedByteArray, compiled_rig);
 
 
 public:
@@ -38,51 +64,273 @@ public:
     ~LightIKPlugin();
 
     void _ready() override;
+    void _enter_tree() override;
+    void _exit_tree() override;
     void _process(double delta) override;
     void _process_modification() override;
 
+    // Solver statistics of the chain, the index is the index of the chain in bone_chains array
+    float get_chain_residual(int chain_index) const;
+    int get_chain_iterations(int chain_index) const;
+
+    // Number of group solves performed and skipped because inputs of the group had not changed
+    int get_solves_count() const                { return (int)m_solvesCount;        }
+    int get_skipped_solves_count() const        { return (int)m_skippedSolvesCount; }
+    // index of the level of detail tier used in the last frame, -1 if no tier is used
+    int get_lod_tier() const                    { return Math::max(m_lodTier, -1);   }
+    // Saves frames kept by the ring buffer capture
+    bool save_capture(const String& path) const;
+
+    // Solver statistics of the last processed frame
+    struct SolveStats
+    {
+        double      timeMs          = 0;
+        int         chainsSolved    = 0;
+        int         iterations      = 0;
+        // chains that used all iterations and still didn't reach the tolerance, counted only if the tolerance is set
+        int         cappedChains    = 0;
+        double      residualSum     = 0;
+        uint64_t    allocations     = 0;
+    };
+    const SolveStats& GetSolveStats() const     { return m_frameStats;              }
+    double GetSolveTimeMs() const               { return m_frameStats.timeMs;       }
+    Dictionary get_solve_stats() const;
+    static Dictionary MakeStatsDictionary(const SolveStats& stats);
+
 protected:
     static void _bind_methods();
     
 private:
     // Build and process skeleton
     void UpdateSkeletonParameters();
+    bool UpdateTopology();
+
+    std::shared_ptr<const SkeletonTopology> m_topology;
+
+    // Pose of the skeleton read on demand, all per frame readers of the pose use the snapshot. The solver needs only bones
+    // of its groups, helpers and the capture read all bones again with global transforms. A plugin prepared by the batch
+    // of another plugin reads the pose twice: the batch reads it before the earlier modifiers and the modification after them
+    const SkeletonPose& GetFramePose();
+    const SkeletonPose& GetFrameGlobals();
+
+    SkeletonPose            m_framePose;
+    // sorted bones of all groups, the chains of the groups include all ancestors of their bones
+    std::vector<int32_t>    m_framePoseBones;
+    uint64_t                m_framePoseFrame            = UINT64_MAX;
+    // all bones are read and their global transforms are composed
+    bool                    m_framePoseFull             = false;
+    // rotations written by the solution are not composed into global transforms yet
+    bool                    m_framePoseDirty            = false;
 
     int                     m_iterationsCount           = 1;
+    float                   m_tolerance                 = 0;
+    float                   m_skipThreshold             = 0;
+    bool                    m_warmStart                 = true;
+    float                   m_warmStartResetDistance    = 0;
+    // solver ticks per second, 0 solves every frame
+    float                   m_updateRateHz              = 0;
+    uint64_t                m_lastSolveTicks            = 0;
+    uint64_t                m_solvesCount               = 0;
+    uint64_t                m_skippedSolvesCount        = 0;
+    SolveStats              m_frameStats;
     bool                    m_simulate                  = false;
-    std::unique_ptr<LightIK::LightIK> m_controllerIK    = nullptr;
+    bool                    m_parallelSolve             = true;
+    // solve together with all other plugins of the frame by LightIKServer
+    bool                    m_batchSolve                = true;
+    uint64_t                m_batchFrame                = UINT64_MAX;
+    // frame of the skeleton callback the modification was processed in the last time
+    uint64_t                m_modificationFrame         = UINT64_MAX;
+    friend class LightIKServer;
 
-    // Build and process chains of all types
+    // Chain that is processed by the controller of the group
+    struct ChainSolver
+    {
+        uint64_t                    chainId     = 0;
+        uint32_t                    chainIndex  = 0;
+        size_t                      solverId    = 0;
+        Node3D*                     target      = nullptr;
+        LightIK::TargetPosition*    pos         = nullptr;
+        // target position in skeleton space used by the last solve
+        Vector3                     lastTarget;
+        // distance between the tip and the target after the last solve
+        real_t                      residual    = 0;
+        // squared distance in the solver precision, updated by every iteration in tolerance mode
+        LightIK::real               residualSquared = 0;
+        // iteration at which the residual first fell under the tolerance, all iterations of the solve if it didn't
+        int                         iterations  = 0;
+        bool                        converged   = false;
+    };
+
+    // Rotation of the bone calculated by the solver
+    struct BoneRotation
+    {
+        int32_t     boneIndex   = -1;
+        Quaternion  rotation;
+    };
+
+    // Chains that share modified bones have to be solved sequentially by the same controller.
+    // Groups don't affect each other, so they are solved in parallel
+    struct SolverGroup
+    {
+        std::unique_ptr<LightIK::LightIK>   controller;
+        std::vector<ChainSolver>            chains;
+        // indices of the chains in the definition the controller is created from
+        std::vector<size_t>                 definitionChains;
+        // sorted list of all bones the chains of the group depend on. The controller is sized to the group,
+        // it knows bones by their indices in this list, not by their indices in the skeleton
+        std::vector<int32_t>                bones;
+        // compact list of rotations produced by the last solve
+        std::vector<BoneRotation>           solution;
+        std::vector<BoneRotation>           previousSolution;
+        // the last solve didn't change the solution, so with the same inputs the solve can be skipped
+        bool                                steady = false;
+        // the controller is created again from the current pose of the skeleton before the next solve
+        bool                                reseed = false;
+        // the controller was created from the frame pose since the last prepared solve, recorded by the capture
+        bool                                reseeded = false;
+        SolveStats                          stats;
+    };
+
+    // Build and process chains of all types. Full build resets all controllers,
+    // while rebuild processes only changed chains and keeps the state of groups that were not affected
     void BuildChains();
-    void BuildTargetChain(ChainIKTarget& chain, uint32_t index);
-    void BuildLinkChain(ChainIKBoneLink& link, uint32_t index);
-    std::vector<LightIK::BoneDesc> BuildRootChain(int32_t tipBone, real_t leafBoneLength);
+    void RebuildChains(const std::unordered_set<uint64_t>& dirtyChains);
+
+    // Inputs and results of the definition compilation. Everything the compilation needs is copied on the main thread,
+    // so the compilation on the worker thread doesn't touch resources, the rig or the plugin. 
+    // Results are applied on the main thread by ApplyBuild
+    struct BuildRequest
+    {
+        uint64_t                                generation  = 0;
+        bool                                    fullBuild   = false;
+        // the definition is compiled from sources of the shared rig and registered in the rig
+        bool                                    rigBuild    = false;
+        std::shared_ptr<const SkeletonTopology> topology;
+        std::shared_ptr<const RigDefinition>    previous;
+        std::unordered_set<uint64_t>            dirtyChains;
+        RigSources                              sources;
+        // the compiled definition of the plugin or of the rig, replaced by the new one if the definition is compiled from sources
+        PackedByteArray                         compiledRig;
+        std::shared_ptr<const RigDefinition>    definition;
+        bool                                    fromCache   = false;
+    };
+    BuildRequest MakeBuildRequest(bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains);
+    static void CompileDefinition(BuildRequest& request);
+    void ApplyBuild(const BuildRequest& request);
+
+    // Build requests of the frame are coalesced into one asynchronous build, the current controllers work until it is finished
+    void RequestBuild(bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains = {});
+    void UpdateBuild();
+    void CompilePendingBuild();
+    void WaitBuild();
+
+    bool                            m_buildRequested        = false;
+    bool                            m_buildRequestFull      = false;
+    // chains changed since the last request, their dirty flags are already consumed
+    std::unordered_set<uint64_t>    m_buildDirtyChains;
+    std::unique_ptr<BuildRequest>   m_pendingBuild;
+    int64_t                         m_buildTaskId           = -1;
+    // synchronous builds make the result of the pending asynchronous build outdated
+    uint64_t                        m_buildGeneration       = 0;
+    void ApplyDefinition(std::shared_ptr<const RigDefinition> definition, const std::unordered_set<uint64_t>& dirtyChains);
+    SolverGroup BuildGroup(const std::vector<size_t>& groupChains, const SkeletonPose& pose) const;
+    // Creates the controller of the group from its chains in the definition, the pose replaces rotations the definition was compiled with
+    void CreateController(SolverGroup& group, const SkeletonPose* pose) const;
+    static int32_t GetGroupBone(const SolverGroup& group, int32_t boneIndex);
+    bool IsSameGroup(const SolverGroup& group, const std::vector<size_t>& groupChains, const std::unordered_set<uint64_t>& dirtyChains) const;
+    // Sets targets from the main thread and collects groups to solve, returns the number of pending groups
+    uint32_t PrepareSolve();
+    void SolvePending(uint32_t pendingCount);
+    void SolveGroup(uint32_t taskIndex);
+    void InvalidateSolution();
+    void ReseedJumpedGroups(const Transform3D& skeletonInverse);
+    void ReseedGroups();
+    bool UpdateResiduals(SolverGroup& group, int iterations, LightIK::real toleranceSquared) const;
+    void CollectStats();
+    const ChainSolver* FindChainSolver(int chainIndex) const;
+    void ApplySolution(real_t weight);
+    void UpdateVisualData();
     void UpdateChainsVisualData();
+    void OnPoseUpdated();
+
+    // Level of detail: the tier is picked from the distance to the camera and the visibility of the skeleton
+    void UpdateLod();
+    void ResumeGroups();
+    void ApplyLodTier(int tierIndex);
+    bool IsVisible(const Camera3D& camera) const;
+    int GetIterationsCount() const;
+    real_t GetUpdateRate() const;
+
+    TypedArray<LightIKLodTier>  m_lodTiers;
+    bool                        m_lodSuspendOffscreen   = false;
+    float                       m_lodVisibilityRadius   = 2;
+    bool                        m_lodSuspended          = false;
+    // -2 means the tier has not been picked yet
+    int                         m_lodTier               = -2;
+    int                         m_lodIterations         = 0;
+    int                         m_lodRateDivisor        = 1;
+    uint64_t                    m_lodFrame              = 0;
+    std::unordered_set<uint32_t> m_lodDisabledChains;
 
-    struct NodeTarget
+    // Capture of solver inputs for the offline replay
+    enum CaptureMode
     {
-        Node3D* target = nullptr;
-        LightIK::TargetPosition* pos;
+        CaptureDisabled,
+        CaptureFile,
+        CaptureRingBuffer,
     };
-    TypedArray<BoneChain>   m_boneChains;
-    std::list<NodeTarget>   m_targets;
+    void CaptureFrame();
+    void StopCapture();
+    String GetCapturePath() const;
+
+    int                         m_captureMode           = CaptureDisabled;
+    String                      m_capturePath           = "user://light_ik_capture.likc";
+    int                         m_captureRingFrames     = 600;
+    std::unique_ptr<CaptureWriter> m_capture;
+    // version of the definition the capture was started with and the number of captures started since the capture was enabled
+    uint64_t                    m_captureVersion        = 0;
+    uint32_t                    m_captureSection        = 0;
+    std::vector<Vector3>        m_captureTargets;
+    std::vector<uint32_t>       m_captureReseeded;
+
+    // chains and constraints of the shared rig replace the own ones of the plugin
+    TypedArray<BoneChain> GetBoneChains() const;
+    TypedArray<JointConstraints> GetConstraintsArray() const;
+
+    Ref<LightIKRig>             m_rig;
+    TypedArray<BoneChain>       m_boneChains;
+    // compiled chains and constraints, shared with other plugins of the same skeleton type and rests if the rig is used.
+    // Controllers created from the definition always belong to the plugin
+    std::shared_ptr<const RigDefinition> m_definition;
+    // binary form of the own definition saved with the scene, loaded by the full build instead of walking the skeleton
+    PackedByteArray             m_compiledRig;
+    // mutable state of the plugin: controllers of the groups
+    std::vector<SolverGroup>    m_groups;
+    // groups which inputs have been changed in the current frame
+    std::vector<uint32_t>       m_pendingGroups;
 
     // Build and process constraints data
     void BuildConstraints();
+    void ApplyConstraints(SolverGroup& group) const;
     void UpdateConstraintsVisualData();
     TypedArray<JointConstraints> m_constraintsArray;
 
     // DEBUG visualization data
-    void AddChainLine(std::vector<LightIK::BoneDesc> chain, int32_t startIndex, int32_t targetIndex, size_t chainId);
+    void AddChainLine(const std::vector<LightIK::BoneDesc>& chain, int32_t startIndex, int32_t targetIndex, size_t groupId, size_t chainId);
     struct ChainDebugInfo
     {
         std::vector<int32_t> indices;
         int32_t startIndex  = -1;
         int32_t targetIndex = -1;
+        size_t groupId      = 0;
         size_t chainId      = 0;
     };
     std::vector<ChainDebugInfo> m_debugChains;
     VisualHelper*           m_helper;
+    // versions of inputs of the visual data, the data is regenerated only if any of them had been changed
+    uint64_t                m_poseVersion       = 0;
+    uint64_t                m_definitionVersion = 0;
+    uint64_t                m_visualVersion     = UINT64_MAX;
     bool                    m_showHelpers   = false;
 
 };
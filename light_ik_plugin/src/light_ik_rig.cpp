@@ -0,0 +1,169 @@
+#include "light_ik_rig.h"
+#include "skeleton_topology.h"
+#include "rig_cache.h"
+
+namespace godot
+{
+
+static bool IsCompiledFor(const RigDefinition& definition, const SkeletonTopology& topology)
+{
+    // skeletons of the same type with different proportions have different lengths of bones
+    return definition.topologyHash == topology.GetHash() && definition.restHash == topology.GetRestHash();
+}
+
+static int64_t GetDefinitionKey(uint64_t topologyHash, uint64_t restHash)
+{
+    // collisions of keys are not a problem, the header of the compiled definition is checked by both hashes
+    return (int64_t)((topologyHash ^ restHash) * 1099511628211ull);
+}
+
+void LightIKRig::_bind_methods()
+{
+    ClassDB::bind_method(D_METHOD("get_bone_chains"), &LightIKRig::get_bone_chains);
+    ClassDB::bind_method(D_METHOD("set_bone_chains", "bone_chains"), &LightIKRig::set_bone_chains);
+    ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "bone_chains", PROPERTY_HINT_TYPE_STRING, 
+            String::num(Variant::OBJECT) + "/" + String::num(PROPERTY_HINT_RESOURCE_TYPE) + ":BoneChain"), "set_bone_chains", "get_bone_chains");
+
+    ClassDB::bind_method(D_METHOD("get_constraints_array"), &LightIKRig::get_constraints_array);
+    ClassDB::bind_method(D_METHOD("set_constraints_array", "constraints_array"), &LightIKRig::set_constraints_array);
+    ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "constraints_array", PROPERTY_HINT_TYPE_STRING, 
+            String::num(Variant::OBJECT) + "/" + String::num(PROPERTY_HINT_RESOURCE_TYPE) + ":JointConstraints"), "set_constraints_array", "get_constraints_array");
+
+    // the cache is loaded after chains and constraints, it is not shown in the inspector
+    ClassDB::bind_method(D_METHOD("get_compiled_definitions"), &LightIKRig::get_compiled_definitions);
+    ClassDB::bind_method(D_METHOD("set_compiled_definitions", "compiled_definitions"), &LightIKRig::set_compiled_definitions);
+    ADD_PROPERTY(PropertyInfo(Variant::DICTIONARY, "compiled_definitions", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_STORAGE), 
+            "set_compiled_definitions", "get_compiled_definitions");
+}
+
+void LightIKRig::set_bone_chains(const TypedArray<BoneChain>& array) 
+{
+    m_boneChains = array;
+    Invalidate();
+}
+
+TypedArray<BoneChain> LightIKRig::get_bone_chains() const 
+{
+    return m_boneChains; 
+}
+
+void LightIKRig::set_constraints_array(const TypedArray<JointConstraints>& array) 
+{
+    m_constraintsArray = array;
+    Invalidate();
+}
+
+TypedArray<JointConstraints> LightIKRig::get_constraints_array() const 
+{
+    return m_constraintsArray; 
+}
+
+void LightIKRig::set_compiled_definitions(const Dictionary& definitions) 
+{
+    m_compiledDefinitions = definitions;
+}
+
+Dictionary LightIKRig::get_compiled_definitions() const 
+{
+    return m_compiledDefinitions; 
+}
+
+void LightIKRig::_ready(Skeleton3D* skeleton)
+{
+    // chains and constraints need the skeleton to provide editor hints
+    for (size_t i = 0; i < m_boneChains.size(); ++i)
+    {
+        BoneChain* chain = Object::cast_to<BoneChain>(m_boneChains[i]);
+        if (chain)
+        {
+            chain->_ready(skeleton);
+        }
+    }
+
+    for (size_t i = 0; i < m_constraintsArray.size(); ++i)
+    {
+        JointConstraints* constraint = Object::cast_to<JointConstraints>(m_constraintsArray[i]);
+        if (constraint)
+        {
+            constraint->_ready(skeleton);
+        }
+    }
+}
+
+std::shared_ptr<const RigDefinition> LightIKRig::FindDefinition(const SkeletonTopology& topology) const
+{
+    for (const auto& definition : m_definitions)
+    {
+        if (IsCompiledFor(*definition, topology))
+        {
+            return definition;
+        }
+    }
+    return nullptr;
+}
+
+PackedByteArray LightIKRig::GetCompiledDefinition(const SkeletonTopology& topology) const
+{
+    return m_compiledDefinitions.get(GetDefinitionKey(topology.GetHash(), topology.GetRestHash()), PackedByteArray());
+}
+
+RigSources LightIKRig::GetSources() const
+{
+    return RigSources::Read(m_boneChains, m_constraintsArray);
+}
+
+std::shared_ptr<const RigDefinition> LightIKRig::AddDefinition(std::shared_ptr<const RigDefinition> definition, const RigSources& sources,
+                                                               const PackedByteArray& compiled)
+{
+    // the rig was edited while the definition was compiled from the copy of its sources
+    if (sources != GetSources())
+    {
+        return nullptr;
+    }
+
+    // another instance of the skeleton type could compile the same definition in the meantime
+    for (const auto& existing : m_definitions)
+    {
+        if (existing->topologyHash == definition->topologyHash && existing->restHash == definition->restHash)
+        {
+            return existing;
+        }
+    }
+
+    if (!compiled.is_empty())
+    {
+        m_compiledDefinitions[GetDefinitionKey(definition->topologyHash, definition->restHash)] = compiled;
+    }
+    sources.ResetDirtyState(m_boneChains, m_constraintsArray, true);
+    m_definitions.emplace_back(definition);
+    return definition;
+}
+
+void LightIKRig::UpdateDirtyState()
+{
+    bool dirty = false;
+    for (size_t c = 0; c < m_boneChains.size(); ++c)
+    {
+        BoneChain* chain = Object::cast_to<BoneChain>(m_boneChains[c]);
+        dirty = (chain && chain->IsDirty()) || dirty;
+    }
+
+    for (size_t c = 0; c < m_constraintsArray.size(); ++c)
+    {
+        JointConstraints* constraint = Object::cast_to<JointConstraints>(m_constraintsArray[c]);
+        dirty = (constraint && constraint->IsDirty()) || dirty;
+    }
+
+    if (dirty)
+    {
+        Invalidate();
+    }
+}
+
+void LightIKRig::Invalidate()
+{
+    // plugins notice the new definition on the next request and rebuild their controllers
+    m_definitions.clear();
+}
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "helpers.h"
+#include "bone_chain.h"
+#include "joint_constraints.h"
+#include "rig_definition.h"
+
+#include <godot_cpp/classes/resource.hpp>
+#include <godot_cpp/classes/skeleton3d.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace godot
+{
+
+/// @brief Set of chains and constraints shared by many identical characters. The rig is compiled once per skeleton type
+/// and rest pose, and all LightIKPlugin instances with such skeletons share the compiled definition.
+/// The sharing stops at the definition level, every instance creates its own controllers seeded from its own pose
+class LightIKRig : public Resource
+{
+    GDCLASS(LightIKRig, Resource)
+    DEFINE_PROPERTY(TypedArray<BoneChain>, bone_chains);
+    DEFINE_PROPERTY(TypedArray<JointConstraints>, constraints_array);
+    DEFINE_PROPERTY(Dictionary, compiled_definitions);
+
+public:
+    void _ready(Skeleton3D* skeleton);
+
+    // The rig is accessed only from the main thread. Plugins copy its sources and the compiled cache of the skeleton type,
+    // compile the definition on the worker thread and register it here, so other instances of the skeleton type share it
+    std::shared_ptr<const RigDefinition> FindDefinition(const SkeletonTopology& topology) const;
+    PackedByteArray GetCompiledDefinition(const SkeletonTopology& topology) const;
+    RigSources GetSources() const;
+    // Returns the registered definition of the skeleton type, or nullptr if the rig was edited after the sources were copied.
+    // The compiled binary is saved with the resource unless it is empty
+    std::shared_ptr<const RigDefinition> AddDefinition(std::shared_ptr<const RigDefinition> definition, const RigSources& sources,
+                                                       const PackedByteArray& compiled);
+    // Drops compiled definitions if any of chains or constraints had been changed
+    void UpdateDirtyState();
+
+protected:
+    static void _bind_methods();
+    void Invalidate();
+
+    TypedArray<BoneChain>                               m_boneChains;
+    TypedArray<JointConstraints>                        m_constraintsArray;
+
+    std::vector<std::shared_ptr<const RigDefinition>>   m_definitions;
+    // binary definitions by the topology and rest hashes of the skeleton, saved together with the resource
+    Dictionary                                          m_compiledDefinitions;
+};
+
+}
@@ -0,0 +1,235 @@
+#include "light_ik_server.h"
+#include "light_ik_plugin.h"
+
+#include <godot_cpp/classes/engine.hpp>
+#include <godot_cpp/classes/performance.hpp>
+#include <godot_cpp/classes/skeleton3d.hpp>
+#include <godot_cpp/classes/worker_thread_pool.hpp>
+#include <godot_cpp/variant/callable_method_pointer.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+
+namespace godot
+{
+
+LightIKServer* LightIKServer::s_singleton = nullptr;
+
+static const char* const MonitorNames[] = {
+    "LightIK/Total Solve Time (ms)", 
+    "LightIK/Batch Time (ms)", 
+    "LightIK/Chains Solved", 
+    "LightIK/Iterations", 
+    "LightIK/Capped Chains", 
+    "LightIK/Average Residual", 
+    "LightIK/Allocations",
+};
+
+void LightIKServer::_bind_methods()
+{
+    ClassDB::bind_method(D_METHOD("get_plugins_count"), &LightIKServer::get_plugins_count);
+    ClassDB::bind_method(D_METHOD("get_batched_groups_count"), &LightIKServer::get_batched_groups_count);
+    ClassDB::bind_method(D_METHOD("get_solve_stats"), &LightIKServer::get_solve_stats);
+}
+
+LightIKServer::LightIKServer()
+{
+    assert(!s_singleton);
+    s_singleton = this;
+}
+
+LightIKServer::~LightIKServer()
+{
+    UnregisterMonitors();
+    s_singleton = nullptr;
+}
+
+void LightIKServer::Register(LightIKPlugin* plugin)
+{
+    if (std::find(m_plugins.begin(), m_plugins.end(), plugin) == m_plugins.end())
+    {
+        m_plugins.emplace_back(plugin);
+    }
+
+    // Performance doesn't exist yet when the extension is initialized, so monitors are added with the first plugin
+    RegisterMonitors();
+    Performance* performance = Performance::get_singleton();
+    if (performance && !m_pluginMonitors.count(plugin))
+    {
+        // the id is kept, the plugin could be renamed before it leaves the tree
+        String monitorId = GetPluginMonitorId(plugin);
+        performance->add_custom_monitor(monitorId, callable_mp(plugin, &LightIKPlugin::GetSolveTimeMs));
+        m_pluginMonitors[plugin] = monitorId;
+    }
+}
+
+void LightIKServer::Unregister(LightIKPlugin* plugin)
+{
+    m_plugins.erase(std::remove(m_plugins.begin(), m_plugins.end(), plugin), m_plugins.end());
+
+    auto monitor = m_pluginMonitors.find(plugin);
+    if (monitor != m_pluginMonitors.end())
+    {
+        if (Performance::get_singleton())
+        {
+            Performance::get_singleton()->remove_custom_monitor(monitor->second);
+        }
+        m_pluginMonitors.erase(monitor);
+    }
+}
+
+String LightIKServer::GetPluginMonitorId(LightIKPlugin* plugin)
+{
+    // the name is not unique in the scene, so the instance id is added
+    return String("LightIK Plugins/") + String(plugin->get_name()) + " #" + String::num_uint64(plugin->get_instance_id()) + " (ms)";
+}
+
+void LightIKServer::RegisterMonitors()
+{
+    Performance* performance = Performance::get_singleton();
+    if (m_monitorsRegistered || !performance)
+    {
+        return;
+    }
+    m_monitorsRegistered = true;
+
+    static_assert(std::size(MonitorNames) == MonitorCount);
+    for (int monitor = 0; monitor < MonitorCount; ++monitor)
+    {
+        Array arguments;
+        arguments.push_back(monitor);
+        performance->add_custom_monitor(MonitorNames[monitor], callable_mp(this, &LightIKServer::GetMonitorValue), arguments);
+    }
+}
+
+void LightIKServer::UnregisterMonitors()
+{
+    Performance* performance = Performance::get_singleton();
+    if (!m_monitorsRegistered || !performance)
+    {
+        return;
+    }
+    m_monitorsRegistered = false;
+
+    for (const char* monitor : MonitorNames)
+    {
+        performance->remove_custom_monitor(monitor);
+    }
+}
+
+double LightIKServer::GetMonitorValue(int monitor) const
+{
+    if (monitor == MonitorBatchTime)
+    {
+        return m_batchTimeMs;
+    }
+
+    Dictionary stats = get_solve_stats();
+    switch (monitor)
+    {
+        case MonitorTotalTime:          return stats["time_ms"];
+        case MonitorChainsSolved:       return stats["chains_solved"];
+        case MonitorIterations:         return stats["iterations"];
+        case MonitorCappedChains:       return stats["capped_chains"];
+        case MonitorAverageResidual:    return stats["average_residual"];
+        case MonitorAllocations:        return stats["allocations"];
+        default:                        return 0;
+    }
+}
+
+Dictionary LightIKServer::get_solve_stats() const
+{
+    LightIKPlugin::SolveStats total;
+    for (const LightIKPlugin* plugin : m_plugins)
+    {
+        const LightIKPlugin::SolveStats& stats = plugin->GetSolveStats();
+        total.timeMs        += stats.timeMs;
+        total.chainsSolved  += stats.chainsSolved;
+        total.iterations    += stats.iterations;
+        total.cappedChains  += stats.cappedChains;
+        total.residualSum   += stats.residualSum;
+        total.allocations   += stats.allocations;
+    }
+
+    Dictionary result = LightIKPlugin::MakeStatsDictionary(total);
+    result["batch_time_ms"] = m_batchTimeMs;
+    result["plugins"]       = (int)m_plugins.size();
+    return result;
+}
+
+uint64_t LightIKServer::GetFrameKey()
+{
+    // skeletons are processed either in process or in physics frames, the key is unique for both
+    Engine* engine = Engine::get_singleton();
+    return (engine->get_physics_frames() << 32) ^ engine->get_process_frames();
+}
+
+uint64_t LightIKServer::GetCallbackFrame(const Skeleton3D* skeleton)
+{
+    Engine* engine = Engine::get_singleton();
+    switch (skeleton->get_modifier_callback_mode_process())
+    {
+        case Skeleton3D::MODIFIER_CALLBACK_MODE_PROCESS_PHYSICS:
+            return engine->get_physics_frames();
+        case Skeleton3D::MODIFIER_CALLBACK_MODE_PROCESS_IDLE:
+            return engine->get_process_frames();
+        default:
+            return UINT64_MAX;
+    }
+}
+
+void LightIKServer::SolveFrame(LightIKPlugin* caller)
+{
+    uint64_t frameKey = GetFrameKey();
+    Skeleton3D::ModifierCallbackModeProcess mode = caller->get_skeleton()->get_modifier_callback_mode_process();
+    uint64_t callbackFrame = GetCallbackFrame(caller->get_skeleton());
+
+    // Targets are read from the main thread. Only skeletons updated in the same callback are batched,
+    // other skeletons would get targets of the wrong frame. Skeletons that were not processed in the previous frame
+    // are not expected to be processed in this one, so they are not solved and not marked as solved
+    auto batchStart = std::chrono::steady_clock::now();
+    m_tasks.clear();
+    for (LightIKPlugin* plugin : m_plugins)
+    {
+        Skeleton3D* skeleton = plugin->get_skeleton();
+        if (!plugin->m_batchSolve || plugin->m_batchFrame == frameKey || !plugin->is_active() || !skeleton || skeleton->get_modifier_callback_mode_process() != mode)
+        {
+            continue;
+        }
+        bool processing = plugin == caller || (callbackFrame != UINT64_MAX && callbackFrame > 0 && plugin->m_modificationFrame == callbackFrame - 1);
+        if (!processing)
+        {
+            continue;
+        }
+
+        plugin->m_batchFrame = frameKey;
+        uint32_t pendingCount = plugin->PrepareSolve();
+        for (uint32_t pendingId = 0; pendingId < pendingCount; ++pendingId)
+        {
+            m_tasks.emplace_back(SolveTaskData{plugin, pendingId});
+        }
+    }
+    m_batchedGroups = m_tasks.size();
+
+    // all groups of all plugins are independent and solved simultaneously
+    if (m_tasks.size() > 1)
+    {
+        WorkerThreadPool* pool = WorkerThreadPool::get_singleton();
+        int64_t taskId = pool->add_group_task(callable_mp(this, &LightIKServer::SolveTask), (int32_t)m_tasks.size(), -1, true, "LightIK batch");
+        pool->wait_for_group_task_completion(taskId);
+    }
+    else if (!m_tasks.empty())
+    {
+        SolveTask(0);
+    }
+    m_batchTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batchStart).count();
+}
+
+void LightIKServer::SolveTask(uint32_t taskIndex)
+{
+    const SolveTaskData& task = m_tasks[taskIndex];
+    task.plugin->SolveGroup(task.pendingId);
+}
+
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <godot_cpp/classes/object.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace godot
+{
+
+class LightIKPlugin;
+class Skeleton3D;
+
+/// @brief Singleton that solves all registered LightIKPlugin instances of the frame in one batch.
+/// The first plugin processed in the frame triggers the batch, the rest of plugins only apply their solutions.
+/// The batch reads targets and poses of other skeletons before their animation and earlier modifiers of the frame run,
+/// so these skeletons are solved with one frame old inputs. Only skeletons processed in the previous frame
+/// of the same callback are batched, other plugins solve themselves when their skeletons are processed
+class LightIKServer : public Object
+{
+    GDCLASS(LightIKServer, Object)
+
+public:
+    static LightIKServer* get_singleton()     { return s_singleton; }
+
+    LightIKServer();
+    ~LightIKServer();
+
+    void Register(LightIKPlugin* plugin);
+    void Unregister(LightIKPlugin* plugin);
+
+    // Solves all registered plugins which were not solved in the current frame, the caller is always included
+    void SolveFrame(LightIKPlugin* caller);
+    // Unique key of the current frame, plugins solved by the batch keep the key of the batch
+    static uint64_t GetFrameKey();
+    // Number of the frame of the callback the skeleton processes its modifiers in, UINT64_MAX for the manual processing
+    static uint64_t GetCallbackFrame(const Skeleton3D* skeleton);
+
+    int get_plugins_count() const               { return (int)m_plugins.size(); }
+    int get_batched_groups_count() const        { return (int)m_batchedGroups;  }
+    // statistics of the last frame summed over all registered plugins
+    Dictionary get_solve_stats() const;
+
+protected:
+    static void _bind_methods();
+
+private:
+    void SolveTask(uint32_t taskIndex);
+
+    // Custom monitors of the Performance singleton
+    enum Monitor
+    {
+        MonitorTotalTime,
+        MonitorBatchTime,
+        MonitorChainsSolved,
+        MonitorIterations,
+        MonitorCappedChains,
+        MonitorAverageResidual,
+        MonitorAllocations,
+        MonitorCount
+    };
+    void RegisterMonitors();
+    void UnregisterMonitors();
+    double GetMonitorValue(int monitor) const;
+    static String GetPluginMonitorId(LightIKPlugin* plugin);
+
+    // group of the plugin pending to be solved by the batch
+    struct SolveTaskData
+    {
+        LightIKPlugin*  plugin      = nullptr;
+        uint32_t        pendingId   = 0;
+    };
+
+    static LightIKServer*       s_singleton;
+    std::vector<LightIKPlugin*> m_plugins;
+    std::vector<SolveTaskData>  m_tasks;
+    size_t                      m_batchedGroups = 0;
+    // wall clock time of the last batch
+    double                      m_batchTimeMs   = 0;
+    bool                        m_monitorsRegistered = false;
+    std::unordered_map<LightIKPlugin*, String> m_pluginMonitors;
+};
+
+}
@@ -2,6 +2,9 @@
 #include <gdextension_interface.h>
 
 #include "light_ik_plugin.h"
+#include "light_ik_rig.h"
+#include "light_ik_lod.h"
+#include "light_ik_server.h"
 #include "bone_chain.h"
 #include "joint_constraints.h"
 #include "visual_helper.h"
@@ -9,10 +12,12 @@
 #include <gdextension_interface.h>
 #include <godot_cpp/core/defs.hpp>
 #include <godot_cpp/godot.hpp>
+#include <godot_cpp/classes/engine.hpp>
 
 using namespace godot;
 
 const godot::ModuleInitializationLevel pluginLevel = MODULE_INITIALIZATION_LEVEL_SCENE;
+static LightIKServer* lightIKServer = nullptr;
 
 void initialize_example_module(ModuleInitializationLevel p_level) 
 {
@@ -27,7 +32,13 @@ void initialize_example_module(ModuleInitializationLevel p_level)
     GDREGISTER_CLASS(ChainIKTarget);
     GDREGISTER_CLASS(ChainIKBoneLink);
     GDREGISTER_CLASS(JointConstraints);
+    GDREGISTER_CLASS(LightIKRig);
+    GDREGISTER_CLASS(LightIKLodTier);
     GDREGISTER_INTERNAL_CLASS(VisualHelper);
+    GDREGISTER_CLASS(LightIKServer);
+
+    lightIKServer = memnew(LightIKServer);
+    Engine::get_singleton()->register_singleton("LightIKServer", lightIKServer);
 }
 
 void uninitialize_example_module(ModuleInitializationLevel p_level) 
@@ -36,6 +47,10 @@ void uninitialize_example_module(ModuleInitializationLevel p_level)
     {
         return;
     }
+
+    Engine::get_singleton()->unregister_singleton("LightIKServer");
+    memdelete(lightIKServer);
+    lightIKServer = nullptr;
 }
 
 extern "C" {
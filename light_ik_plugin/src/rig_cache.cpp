@@ -0,0 +1,306 @@
+#include "rig_cache.h"
+
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+namespace godot
+{
+
+namespace
+{
+
+// Layout of the cache. Solver types are stored as is, so the cache is valid only for the solver with the same types
+//
+//  CacheHeader
+//  chains      [chainCount]        ChainHeader, UTF-8 target path, BoneDesc rootChain[], BoneDesc targetChain[]
+//  groups      [groupCount]        uint32_t count, uint32_t chains[count]
+//  constraints [constraintCount]   BoneConstraint
+constexpr char      CacheMagic[8]   = {'L', 'I', 'K', 'R', 'I', 'G', 0, 0};
+constexpr uint32_t  CacheVersion    = 5;
+
+static_assert(std::is_trivially_copyable_v<LightIK::BoneDesc>);
+static_assert(std::is_trivially_copyable_v<BoneConstraint>);
+
+struct CacheHeader
+{
+    char        magic[8]        = {};
+    uint32_t    version         = CacheVersion;
+    uint32_t    realSize        = sizeof(LightIK::real);
+    uint32_t    boneDescSize    = sizeof(LightIK::BoneDesc);
+    uint32_t    constraintSize  = sizeof(BoneConstraint);
+    uint64_t    topologyHash    = 0;
+    uint64_t    restHash        = 0;
+    uint64_t    sourceHash      = 0;
+    int32_t     boneCount       = 0;
+    uint32_t    chainCount      = 0;
+    uint32_t    groupCount      = 0;
+    uint32_t    constraintCount = 0;
+};
+
+struct ChainHeader
+{
+    uint32_t    chainIndex      = 0;
+    int32_t     startBone       = -1;
+    int32_t     targetBone      = -1;
+    uint32_t    targetPathSize  = 0;
+    uint32_t    rootChainSize   = 0;
+    uint32_t    targetChainSize = 0;
+};
+
+class CacheWriter
+{
+public:
+    template <typename T>
+    void Write(const T& value)                      { Write(&value, sizeof(T));                                                 }
+    template <typename T>
+    void Write(const std::vector<T>& values)        { Write(values.data(), values.size() * sizeof(T));                         }
+    void Write(const void* data, size_t size)       { m_data.insert(m_data.end(), (const uint8_t*)data, (const uint8_t*)data + size); }
+
+    PackedByteArray GetData() const
+    {
+        PackedByteArray data;
+        data.resize((int64_t)m_data.size());
+        std::memcpy(data.ptrw(), m_data.data(), m_data.size());
+        return data;
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+class CacheReader
+{
+public:
+    explicit CacheReader(const PackedByteArray& data) : m_data(data.ptr()), m_size((size_t)data.size()) {}
+
+    template <typename T>
+    bool Read(T& value)                             { return Read(&value, sizeof(T));                                           }
+    template <typename T>
+    bool Read(std::vector<T>& values, size_t count)
+    {
+        if (count * sizeof(T) > m_size - m_offset)
+        {
+            return false;
+        }
+        values.resize(count);
+        return Read(values.data(), count * sizeof(T));
+    }
+    bool Read(void* data, size_t size)
+    {
+        if (size > m_size - m_offset)
+        {
+            return false;
+        }
+        std::memcpy(data, m_data + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+private:
+    const uint8_t*  m_data      = nullptr;
+    size_t          m_size      = 0;
+    size_t          m_offset    = 0;
+};
+
+// FNV-1a, the same hash as the topology of the skeleton uses
+void HashValue(uint64_t& hash, uint64_t value)
+{
+    hash = (hash ^ value) * 1099511628211ull;
+}
+
+void HashReal(uint64_t& hash, double value)
+{
+    uint64_t bits = 0;
+    std::memcpy(&bits, &value, sizeof(bits));
+    HashValue(hash, bits);
+}
+
+}
+
+uint64_t RigCache::GetSourceHash(const RigSources& sources)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const ChainSource& chain : sources.chains)
+    {
+        if (chain.type == ChainSource::ChainNone)
+        {
+            HashValue(hash, 0);
+            continue;
+        }
+
+        HashValue(hash, chain.rootBone.hash());
+        HashValue(hash, chain.tipBone.hash());
+        HashReal(hash, chain.leafBoneLength);
+        if (chain.type == ChainSource::ChainTarget)
+        {
+            HashValue(hash, 1);
+            HashValue(hash, String(chain.targetPath).hash());
+        }
+        else
+        {
+            HashValue(hash, 2);
+            HashValue(hash, chain.targetBone.hash());
+        }
+    }
+
+    for (const ConstraintSource& constraint : sources.constraints)
+    {
+        if (!constraint.constraintId)
+        {
+            HashValue(hash, 0);
+            continue;
+        }
+
+        const ConstraintData& data = constraint.data;
+        HashValue(hash, data.boneName.hash());
+        for (const Vector3* angles : {&data.angleMin, &data.angleMax})
+        {
+            HashReal(hash, angles->x);
+            HashReal(hash, angles->y);
+            HashReal(hash, angles->z);
+        }
+        HashReal(hash, data.flexibility);
+        HashValue(hash, (uint64_t)data.rotationOrder);
+        HashValue(hash, (uint64_t)data.rotationDirection);
+    }
+    return hash;
+}
+
+PackedByteArray RigCache::Serialize(const RigDefinition& definition, uint64_t sourceHash)
+{
+    CacheHeader header;
+    std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+    header.topologyHash     = definition.topologyHash;
+    header.restHash         = definition.restHash;
+    header.sourceHash       = sourceHash;
+    header.boneCount        = definition.boneCount;
+    header.chainCount       = (uint32_t)definition.chains.size();
+    header.groupCount       = (uint32_t)definition.groups.size();
+    header.constraintCount  = (uint32_t)definition.constraints.size();
+
+    CacheWriter writer;
+    writer.Write(header);
+    for (const ChainDefinition& chain : definition.chains)
+    {
+        CharString targetPath = String(chain.targetPath).utf8();
+        writer.Write(ChainHeader{chain.chainIndex, chain.startBone, chain.targetBone, (uint32_t)targetPath.length(),
+                                 (uint32_t)chain.rootChain.size(), (uint32_t)chain.targetChain.size()});
+        writer.Write(targetPath.get_data(), (size_t)targetPath.length());
+        writer.Write(chain.rootChain);
+        writer.Write(chain.targetChain);
+    }
+
+    for (const auto& group : definition.groups)
+    {
+        writer.Write((uint32_t)group.size());
+        for (size_t c : group)
+        {
+            writer.Write((uint32_t)c);
+        }
+    }
+    writer.Write(definition.constraints);
+    return writer.GetData();
+}
+
+static bool IsBone(int32_t bone, int32_t boneCount)
+{
+    return bone >= 0 && bone < boneCount;
+}
+
+std::shared_ptr<const RigDefinition> RigCache::Deserialize(const PackedByteArray& data, uint64_t topologyHash, uint64_t restHash, uint64_t sourceHash,
+                                                           const RigSources& sources)
+{
+    CacheReader reader(data);
+    CacheHeader header;
+    CacheHeader expected;
+    if (!reader.Read(header) || std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) || header.version != expected.version
+        || header.realSize != expected.realSize || header.boneDescSize != expected.boneDescSize || header.constraintSize != expected.constraintSize
+        || header.topologyHash != topologyHash || header.restHash != restHash || header.sourceHash != sourceHash)
+    {
+        return nullptr;
+    }
+
+    auto definition = std::make_shared<RigDefinition>();
+    definition->topologyHash    = header.topologyHash;
+    definition->restHash        = header.restHash;
+    definition->boneCount       = header.boneCount;
+    for (uint32_t c = 0; c < header.chainCount; ++c)
+    {
+        ChainHeader chainHeader;
+        if (!reader.Read(chainHeader) || chainHeader.chainIndex >= (uint32_t)sources.chains.size())
+        {
+            return nullptr;
+        }
+
+        ChainDefinition& chain = definition->chains.emplace_back();
+        // the instance of the chain resource is different in every session
+        chain.chainId       = sources.chains[chainHeader.chainIndex].chainId;
+        chain.chainIndex    = chainHeader.chainIndex;
+        chain.startBone     = chainHeader.startBone;
+        chain.targetBone    = chainHeader.targetBone;
+
+        std::vector<char> targetPath;
+        if (!reader.Read(targetPath, chainHeader.targetPathSize)
+            || !reader.Read(chain.rootChain, chainHeader.rootChainSize)
+            || !reader.Read(chain.targetChain, chainHeader.targetChainSize))
+        {
+            return nullptr;
+        }
+        if (!targetPath.empty())
+        {
+            chain.targetPath = NodePath(String::utf8(targetPath.data(), (int64_t)targetPath.size()));
+        }
+
+        // controllers and the write back index the pose by these bones, so the cache with any other bone is rejected
+        if (!IsBone(chain.startBone, header.boneCount) || (chain.targetBone >= 0 && !IsBone(chain.targetBone, header.boneCount)))
+        {
+            return nullptr;
+        }
+        for (const auto* boneChain : {&chain.rootChain, &chain.targetChain})
+        {
+            for (const LightIK::BoneDesc& bone : *boneChain)
+            {
+                if (!IsBone(bone.boneIndex, header.boneCount))
+                {
+                    return nullptr;
+                }
+            }
+        }
+    }
+
+    definition->groups.resize(header.groupCount);
+    for (auto& group : definition->groups)
+    {
+        uint32_t count = 0;
+        std::vector<uint32_t> groupChains;
+        if (!reader.Read(count) || !reader.Read(groupChains, count))
+        {
+            return nullptr;
+        }
+        for (uint32_t c : groupChains)
+        {
+            if (c >= header.chainCount)
+            {
+                return nullptr;
+            }
+            group.emplace_back(c);
+        }
+    }
+
+    if (!reader.Read(definition->constraints, header.constraintCount))
+    {
+        return nullptr;
+    }
+    for (const BoneConstraint& constraint : definition->constraints)
+    {
+        if (!IsBone(constraint.boneIndex, header.boneCount))
+        {
+            return nullptr;
+        }
+    }
+    RigBuilder::IndexConstraints(*definition);
+    return definition;
+}
+
+}
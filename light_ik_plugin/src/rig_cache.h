@@ -0,0 +1,26 @@
+#pragma once
+
+#include "rig_definition.h"
+
+#include <godot_cpp/variant/packed_byte_array.hpp>
+
+#include <memory>
+
+namespace godot
+{
+
+/// @brief Binary form of the compiled rig definition. The definition is stored together with the resource
+/// that describes the rig, and loaded instead of walking the skeleton while hashes of the skeleton, its rests and sources match
+class RigCache
+{
+public:
+    // hash of all chain and constraint parameters the definition is compiled from
+    static uint64_t GetSourceHash(const RigSources& sources);
+
+    static PackedByteArray Serialize(const RigDefinition& definition, uint64_t sourceHash);
+    // returns nullptr if the data is compiled for another skeleton or rest pose, from other sources or by the solver with other types
+    static std::shared_ptr<const RigDefinition> Deserialize(const PackedByteArray& data, uint64_t topologyHash, uint64_t restHash, uint64_t sourceHash,
+                                                            const RigSources& sources);
+};
+
+}
@@ -0,0 +1,418 @@
+#include "rig_definition.h"
+#include "skeleton_topology.h"
+#include "conversions.h"
+
+#include <godot_cpp/variant/utility_functions.hpp>
+
+#include <algorithm>
+#include <numeric>
+
+namespace godot
+{
+
+ChainSource ChainSource::Read(BoneChain* chain)
+{
+    ChainSource source;
+    if (!chain)
+    {
+        return source;
+    }
+
+    source.chainId          = (uint64_t)chain->get_instance_id();
+    source.rootBone         = chain->GetRootBone();
+    source.tipBone          = chain->GetTipBone();
+    source.leafBoneLength   = chain->GetLeafBoneLength();
+    if (ChainIKTarget* target = Object::cast_to<ChainIKTarget>(chain))
+    {
+        source.type         = ChainTarget;
+        source.targetPath   = target->GetTargetPath();
+    }
+    else if (ChainIKBoneLink* link = Object::cast_to<ChainIKBoneLink>(chain))
+    {
+        source.type         = ChainLink;
+        source.targetBone   = link->GetTargetBone();
+    }
+    return source;
+}
+
+ConstraintSource ConstraintSource::Read(JointConstraints* constraint)
+{
+    ConstraintSource source;
+    if (constraint)
+    {
+        source.constraintId = (uint64_t)constraint->get_instance_id();
+        source.data         = constraint->GetConstraintData();
+    }
+    return source;
+}
+
+RigSources RigSources::Read(const TypedArray<BoneChain>& chains, const TypedArray<JointConstraints>& constraints)
+{
+    RigSources sources;
+    sources.chains.reserve(chains.size());
+    for (size_t i = 0; i < chains.size(); ++i)
+    {
+        sources.chains.emplace_back(ChainSource::Read(Object::cast_to<BoneChain>(chains[i])));
+    }
+
+    sources.constraints.reserve(constraints.size());
+    for (size_t i = 0; i < constraints.size(); ++i)
+    {
+        sources.constraints.emplace_back(ConstraintSource::Read(Object::cast_to<JointConstraints>(constraints[i])));
+    }
+    return sources;
+}
+
+void RigSources::ResetDirtyState(const TypedArray<BoneChain>& chains, const TypedArray<JointConstraints>& constraints,
+                                 bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains) const
+{
+    for (size_t i = 0; i < chains.size() && i < this->chains.size(); ++i)
+    {
+        BoneChain* chain = Object::cast_to<BoneChain>(chains[i]);
+        const ChainSource& source = this->chains[i];
+        if (chain && (fullBuild || dirtyChains.count(source.chainId)) && ChainSource::Read(chain) == source)
+        {
+            chain->IsDirty();
+        }
+    }
+
+    for (size_t i = 0; i < constraints.size() && i < this->constraints.size(); ++i)
+    {
+        JointConstraints* constraint = Object::cast_to<JointConstraints>(constraints[i]);
+        if (constraint && ConstraintSource::Read(constraint) == this->constraints[i])
+        {
+            constraint->IsDirty();
+        }
+    }
+}
+
+void SkeletonPose::Read(Skeleton3D* skeleton, const SkeletonTopology& topology)
+{
+    int32_t boneCount = topology.GetBoneCount();
+    rotations.resize(boneCount);
+    locals.resize(boneCount);
+    globals.resize(boneCount);
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        // one call per bone, the rotation is taken from the basis of the pose
+        locals[bone]    = skeleton->get_bone_pose(bone);
+        rotations[bone] = locals[bone].basis.get_rotation_quaternion();
+    }
+    UpdateGlobals(topology);
+}
+
+void SkeletonPose::Read(Skeleton3D* skeleton, const SkeletonTopology& topology, const std::vector<int32_t>& bones)
+{
+    int32_t boneCount = topology.GetBoneCount();
+    rotations.resize(boneCount);
+    locals.resize(boneCount);
+    globals.resize(boneCount);
+    for (int32_t bone : bones)
+    {
+        if (bone < boneCount)
+        {
+            locals[bone]    = skeleton->get_bone_pose(bone);
+            rotations[bone] = locals[bone].basis.get_rotation_quaternion();
+        }
+    }
+}
+
+void SkeletonPose::SetRotation(int32_t bone, const Quaternion& rotation)
+{
+    // the basis of the pose is the rotation multiplied by the scale, so the scale is kept by the difference of rotations
+    locals[bone].basis  = Basis(rotation * rotations[bone].inverse()) * locals[bone].basis;
+    rotations[bone]     = rotation;
+}
+
+void SkeletonPose::UpdateGlobals(const SkeletonTopology& topology)
+{
+    // the same composition as Skeleton3D does for global poses of bones
+    for (int32_t bone : topology.GetProcessOrder())
+    {
+        int32_t parent = topology.GetParent(bone);
+        globals[bone] = parent >= 0 ? globals[parent] * locals[bone] : locals[bone];
+    }
+}
+
+void SkeletonPose::ReadRest(const SkeletonTopology& topology)
+{
+    int32_t boneCount = topology.GetBoneCount();
+    rotations.resize(boneCount);
+    locals.resize(boneCount);
+    globals.resize(boneCount);
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        locals[bone]    = topology.GetRest(bone);
+        rotations[bone] = locals[bone].basis.get_rotation_quaternion();
+    }
+    UpdateGlobals(topology);
+}
+
+RigBuilder::RigBuilder(std::shared_ptr<const SkeletonTopology> topology)
+    : m_topology(std::move(topology))
+{
+    assert(m_topology);
+    m_pose.ReadRest(*m_topology);
+}
+
+std::shared_ptr<const RigDefinition> RigBuilder::Build(const RigSources& sources, const RigDefinition* previous,
+                                                       const std::unordered_set<uint64_t>& dirtyChains) const
+{
+    auto definition = std::make_shared<RigDefinition>();
+    definition->topologyHash    = m_topology->GetHash();
+    definition->restHash        = m_topology->GetRestHash();
+    definition->boneCount       = m_topology->GetBoneCount();
+
+    // Collect all chains from the skeleton, chains that were not changed are taken from the previous build
+    for (size_t i = 0; i < sources.chains.size(); ++i)
+    {
+        const ChainSource& source = sources.chains[i];
+        uint64_t chainId = source.chainId;
+        if (source.type != ChainSource::ChainNone && previous && !dirtyChains.count(chainId))
+        {
+            auto cached = std::find_if(previous->chains.begin(), previous->chains.end(), [chainId](const ChainDefinition& chain) { return chain.chainId == chainId; });
+            if (cached != previous->chains.end())
+            {
+                auto& chain = definition->chains.emplace_back(*cached);
+                chain.chainIndex  = i;
+                chain.rebuilt     = false;
+                continue;
+            }
+        }
+
+        ChainDefinition chainDefinition;
+        chainDefinition.chainId = chainId;
+        if (source.type == ChainSource::ChainTarget)
+        {
+            if (BuildTargetChain(source, i, chainDefinition))
+            {
+                definition->chains.emplace_back(std::move(chainDefinition));
+            }
+            continue;
+        } 
+    
+        if (source.type == ChainSource::ChainLink)
+        {
+            if (BuildLinkChain(source, i, chainDefinition))
+            {
+                definition->chains.emplace_back(std::move(chainDefinition));
+            }
+            continue;
+        }
+
+        UtilityFunctions::push_error("The ", i, "th chain is not set");
+    }
+
+    definition->groups      = PartitionChains(definition->chains);
+    definition->constraints = CollectConstraints(sources.constraints);
+    IndexConstraints(*definition);
+    return definition;
+}
+
+std::shared_ptr<const RigDefinition> RigBuilder::BuildConstraints(const RigDefinition& definition, const std::vector<ConstraintSource>& constraints) const
+{
+    auto newDefinition = std::make_shared<RigDefinition>(definition);
+    newDefinition->constraints = CollectConstraints(constraints);
+    IndexConstraints(*newDefinition);
+    return newDefinition;
+}
+
+bool RigBuilder::BuildTargetChain(const ChainSource& chain, uint32_t index, ChainDefinition& definition) const
+{
+    // build chain of bones
+    int32_t chainTipBone    = m_topology->FindBone(chain.tipBone);
+    int32_t chainStartBone  = m_topology->FindBone(chain.rootBone);
+    
+    // if parameters are invalid, no need to build this chain
+    if (chain.targetPath.is_empty() || chainTipBone < 0 || chainStartBone < 0 )
+    {
+        UtilityFunctions::push_error("The ", index, "th chain cannot be created, parameters are invalid");
+        return false;
+    }
+
+    definition.chainIndex   = index;
+    definition.targetPath   = chain.targetPath;
+    definition.startBone    = chainStartBone;
+    definition.rootChain    = BuildRootChain(chainTipBone, chain.leafBoneLength);
+    return true;
+}
+
+bool RigBuilder::BuildLinkChain(const ChainSource& link, uint32_t index, ChainDefinition& definition) const
+{
+    // find bones in the skeleton to build the link
+    int32_t chainTipBone    = m_topology->FindBone(link.tipBone);
+    int32_t chainStartBone  = m_topology->FindBone(link.rootBone);
+    int32_t chainTargetBone = m_topology->FindBone(link.targetBone);
+
+    // if parameters are invalid, no need to build this chain
+    if (chainTargetBone < 0 || chainTipBone < 0 || chainStartBone < 0 )
+    {
+        UtilityFunctions::push_error("The ", index, " link cannot be created, parameters are invalid");
+        return false;            
+    }
+
+    definition.chainIndex   = index;
+    definition.startBone    = chainStartBone;
+    definition.targetBone   = chainTargetBone;
+    definition.rootChain    = BuildRootChain(chainTipBone, link.leafBoneLength);
+    definition.targetChain  = BuildRootChain(chainTargetBone, 1.0);
+    return true;
+}
+
+std::vector<LightIK::BoneDesc> RigBuilder::BuildRootChain(int32_t tipBone, real_t leafBoneLength) const
+{
+    std::vector<LightIK::BoneDesc> rootChain;
+
+    // Build the root chain 
+    Vector3 parentPosition = m_pose.globals[tipBone].origin;
+
+    const auto& children = m_topology->GetChildren(tipBone);
+    if (children.size())
+    {
+        // If child available calculate the length of the tip bone using its real parameters
+        parentPosition = m_pose.globals[children[0]].origin;
+    }
+    else
+    {
+        // If tip bone is the leaf bone, consider the length of the bone is 1
+        LightIK::Quaternion rotation = ToLightIKQuaternion(m_pose.rotations[tipBone]);
+        rootChain.emplace_back(LightIK::BoneDesc{rotation, leafBoneLength, tipBone});
+        tipBone = m_topology->GetParent(tipBone);
+    }
+
+    while(tipBone >= 0)
+    {
+        // Collect local rotation of the bone
+        LightIK::Quaternion rotation = ToLightIKQuaternion(m_pose.rotations[tipBone]);
+        
+        // Calculate the length of the bone by using position of current and previous joint
+        Vector3 currentPosition = m_pose.globals[tipBone].origin;
+        real_t length = (currentPosition - parentPosition).length();
+
+        // Add bone to the root chain
+        rootChain.emplace_back(LightIK::BoneDesc{rotation, length, tipBone});
+
+        // Proceed to the next bone
+        parentPosition = currentPosition;
+        tipBone = m_topology->GetParent(tipBone);
+    }
+    // the array is filled from tip to root, to work properly with arrays, need to reverse them
+    // TODO: REALLY?
+    std::reverse(rootChain.begin(), rootChain.end());
+    return rootChain;
+}
+
+std::vector<std::vector<size_t>> RigBuilder::PartitionChains(const std::vector<ChainDefinition>& chains) const
+{
+    // Chain modifies the bones from its start bone to the tip, but depends on all bones down to the skeleton root.
+    // Two chains are dependent if one of them modifies any bone the other one depends on
+    std::vector<size_t> parents(chains.size());
+    std::iota(parents.begin(), parents.end(), 0);
+    auto findGroup = [&parents](size_t chain)
+    {
+        while (parents[chain] != chain)
+        {
+            parents[chain] = parents[parents[chain]];
+            chain = parents[chain];
+        }
+        return chain;
+    };
+
+    std::vector<std::vector<size_t>> modifiers(m_topology->GetBoneCount());
+    for (size_t c = 0; c < chains.size(); ++c)
+    {
+        const auto& rootChain = chains[c].rootChain;
+        auto start = std::find_if(rootChain.begin(), rootChain.end(), [&](const LightIK::BoneDesc& bone) { return bone.boneIndex == chains[c].startBone; });
+        // if the start bone is not in the chain, consider the whole chain as modified
+        for (auto bone = (start != rootChain.end() ? start : rootChain.begin()); bone != rootChain.end(); ++bone)
+        {
+            modifiers[bone->boneIndex].emplace_back(c);
+        }
+    }
+
+    for (size_t c = 0; c < chains.size(); ++c)
+    {
+        for (const auto* boneChain : {&chains[c].rootChain, &chains[c].targetChain})
+        {
+            for (const LightIK::BoneDesc& bone : *boneChain)
+            {
+                for (size_t modifier : modifiers[bone.boneIndex])
+                {
+                    parents[findGroup(modifier)] = findGroup(c);
+                }
+            }
+        }
+    }
+
+    // Keep the original order of chains inside groups and the order of groups by their first chain
+    std::vector<std::vector<size_t>> groups;
+    std::vector<size_t> groupIndices(chains.size(), chains.size());
+    for (size_t c = 0; c < chains.size(); ++c)
+    {
+        size_t root = findGroup(c);
+        if (groupIndices[root] == chains.size())
+        {
+            groupIndices[root] = groups.size();
+            groups.emplace_back();
+        }
+        groups[groupIndices[root]].emplace_back(c);
+    }
+
+    return groups;
+}
+
+std::vector<BoneConstraint> RigBuilder::CollectConstraints(const std::vector<ConstraintSource>& constraints) const
+{
+    std::vector<BoneConstraint> boneConstraints;
+    for (const ConstraintSource& source : constraints)
+    {
+        if (source.constraintId)
+        {
+            const ConstraintData& data = source.data;
+            LightIK::Constraints constraint {
+                (LightIK::ConstraintModes)data.rotationOrder,
+                (LightIK::ConstraintRotation)data.rotationDirection,
+                data.flexibility,
+                ToLightIKVector((2.0 * Math_PI) * data.angleMin / 360.0),
+                ToLightIKVector((2.0 * Math_PI) * data.angleMax / 360.0),
+            };
+            int32_t boneIndex = m_topology->FindBone(data.boneName);
+            if (boneIndex >= 0)
+            {
+                boneConstraints.emplace_back(BoneConstraint{boneIndex, std::move(constraint)});
+            }
+            else
+            {
+                UtilityFunctions::push_error("Constraint cannot be set. Bone ", data.boneName, " not found");    
+            }
+        }
+    }
+
+    // the solver keeps one constraint per bone, so the last constraint of the bone wins
+    std::stable_sort(boneConstraints.begin(), boneConstraints.end(), 
+        [](const BoneConstraint& a, const BoneConstraint& b) { return a.boneIndex < b.boneIndex; });
+    std::vector<BoneConstraint> uniqueConstraints;
+    for (const BoneConstraint& constraint : boneConstraints)
+    {
+        if (!uniqueConstraints.empty() && uniqueConstraints.back().boneIndex == constraint.boneIndex)
+        {
+            uniqueConstraints.back() = constraint;
+        }
+        else
+        {
+            uniqueConstraints.emplace_back(constraint);
+        }
+    }
+    return uniqueConstraints;
+}
+
+void RigBuilder::IndexConstraints(RigDefinition& definition)
+{
+    definition.boneConstraints.assign(definition.boneCount, -1);
+    for (size_t c = 0; c < definition.constraints.size(); ++c)
+    {
+        definition.boneConstraints[definition.constraints[c].boneIndex] = (int32_t)c;
+    }
+}
+
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "light_ik/light_ik.h"
+#include "bone_chain.h"
+#include "joint_constraints.h"
+
+#include <godot_cpp/classes/skeleton3d.hpp>
+#include <godot_cpp/variant/node_path.hpp>
+#include <godot_cpp/variant/typed_array.hpp>
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+namespace godot
+{
+
+class SkeletonTopology;
+
+// Description of a single chain, collected from the skeleton before the chain is sent to the solver
+struct ChainDefinition
+{
+    uint64_t                        chainId     = 0;        // instance id of the chain resource
+    uint32_t                        chainIndex  = 0;
+    bool                            rebuilt     = true;     // chain was rebuilt from the skeleton, not taken from the previous definition
+    std::vector<LightIK::BoneDesc>  rootChain;
+    std::vector<LightIK::BoneDesc>  targetChain;
+    int32_t                         startBone   = -1;
+    int32_t                         targetBone  = -1;
+    NodePath                        targetPath;             // relative to the plugin, empty for links
+};
+
+struct BoneConstraint
+{
+    int32_t                         boneIndex = -1;
+    LightIK::Constraints            constraint;
+};
+
+// Parameters of the chain resource copied on the main thread. The definition is compiled from the copy,
+// so the compilation on the worker thread doesn't access resources that can be edited at the same time
+struct ChainSource
+{
+    enum Type
+    {
+        ChainNone,
+        ChainTarget,
+        ChainLink,
+    };
+
+    Type                            type            = ChainNone;
+    uint64_t                        chainId         = 0;        // instance id of the chain resource
+    String                          rootBone;
+    String                          tipBone;
+    real_t                          leafBoneLength  = 1;
+    NodePath                        targetPath;
+    String                          targetBone;
+
+    static ChainSource Read(BoneChain* chain);
+    bool operator==(const ChainSource& other) const = default;
+};
+
+struct ConstraintSource
+{
+    uint64_t                        constraintId    = 0;        // instance id of the constraint resource, 0 if the slot is empty
+    ConstraintData                  data;
+
+    static ConstraintSource Read(JointConstraints* constraint);
+    bool operator==(const ConstraintSource& other) const = default;
+};
+
+// Copy of all chain and constraint resources the definition is compiled from
+struct RigSources
+{
+    std::vector<ChainSource>        chains;
+    std::vector<ConstraintSource>   constraints;
+
+    static RigSources Read(const TypedArray<BoneChain>& chains, const TypedArray<JointConstraints>& constraints);
+    // Resets dirty flags of resources the definition was compiled from, called on the main thread once the definition is applied.
+    // Resources edited after the copy was made stay dirty. Chains are reset only if they were rebuilt: all chains of the full build
+    // and the dirty chains of the partial one
+    void ResetDirtyState(const TypedArray<BoneChain>& chains, const TypedArray<JointConstraints>& constraints,
+                         bool fullBuild, const std::unordered_set<uint64_t>& dirtyChains = {}) const;
+    bool operator==(const RigSources& other) const = default;
+};
+
+/// @brief Immutable description of the rig compiled for the skeleton: chains, their grouping and constraints.
+/// The definition doesn't depend on the plugin instance, so it can be shared by all skeletons of the same type and rest pose
+struct RigDefinition
+{
+    uint64_t                            topologyHash = 0;
+    uint64_t                            restHash     = 0;
+    int32_t                             boneCount    = 0;
+    std::vector<ChainDefinition>        chains;
+    // indices of chains that depend on each other and have to be solved by the same controller, in the order of bone_chains
+    std::vector<std::vector<size_t>>    groups;
+    // one constraint per bone sorted by the bone index, and the lookup table of indices of constraints by the bone.
+    // The table only finds constraints of bones of a group, the solver still receives and evaluates them one by one
+    std::vector<BoneConstraint>         constraints;
+    std::vector<int32_t>                boneConstraints;
+};
+
+// Snapshot of the skeleton pose. The pose is read from the skeleton in one pass and global transforms are composed
+// from local poses here, so consumers of the snapshot don't call the skeleton for every bone they need
+struct SkeletonPose
+{
+    std::vector<Quaternion>         rotations;  // local pose rotations
+    std::vector<Transform3D>        locals;     // local pose transforms
+    std::vector<Transform3D>        globals;    // transforms of bones in the skeleton space
+
+    // Reads local poses of all bones and composes their global transforms
+    void Read(Skeleton3D* skeleton, const SkeletonTopology& topology);
+    // Reads local poses of the listed bones only, global transforms are not updated
+    void Read(Skeleton3D* skeleton, const SkeletonTopology& topology, const std::vector<int32_t>& bones);
+    // rest pose of the topology, the rig is compiled from it
+    void ReadRest(const SkeletonTopology& topology);
+    // Replaces the local rotation of the bone, global transforms are updated by UpdateGlobals
+    void SetRotation(int32_t bone, const Quaternion& rotation);
+    void UpdateGlobals(const SkeletonTopology& topology);
+};
+
+/// @brief Compiles chain and constraint resources into the rig definition using the rest pose of the skeleton.
+/// Lengths of bones and rotations chains are created with depend only on the topology, so chains can be compiled
+/// on the worker thread without access to the skeleton
+class RigBuilder
+{
+public:
+    explicit RigBuilder(std::shared_ptr<const SkeletonTopology> topology);
+
+    // Builds the definition, chains of the previous definition that are not dirty are reused as is
+    std::shared_ptr<const RigDefinition> Build(const RigSources& sources, const RigDefinition* previous = nullptr,
+                                               const std::unordered_set<uint64_t>& dirtyChains = {}) const;
+    // Builds the copy of the definition with the new set of constraints
+    std::shared_ptr<const RigDefinition> BuildConstraints(const RigDefinition& definition, const std::vector<ConstraintSource>& constraints) const;
+    // Fills the table of constraints by the bone, the table is not stored and built for every loaded definition
+    static void IndexConstraints(RigDefinition& definition);
+
+private:
+    bool BuildTargetChain(const ChainSource& chain, uint32_t index, ChainDefinition& definition) const;
+    bool BuildLinkChain(const ChainSource& link, uint32_t index, ChainDefinition& definition) const;
+    std::vector<LightIK::BoneDesc> BuildRootChain(int32_t tipBone, real_t leafBoneLength) const;
+    std::vector<std::vector<size_t>> PartitionChains(const std::vector<ChainDefinition>& chains) const;
+    std::vector<BoneConstraint> CollectConstraints(const std::vector<ConstraintSource>& constraints) const;
+
+    std::shared_ptr<const SkeletonTopology> m_topology;
+    SkeletonPose                            m_pose;
+};
+
+}
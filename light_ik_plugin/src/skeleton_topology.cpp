@@ -0,0 +1,160 @@
+#include "skeleton_topology.h"
+
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace godot
+{
+
+std::shared_ptr<const SkeletonTopology> SkeletonTopology::Get(Skeleton3D* skeleton)
+{
+    // topologies are shared between plugins, chains and constraints of all skeletons, cache keeps only alive ones
+    static std::mutex cacheMutex;
+    static std::unordered_map<uint64_t, std::weak_ptr<SkeletonTopology>> cache;
+
+    assert(skeleton);
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto& cached = cache[skeleton->get_instance_id()];
+    std::shared_ptr<SkeletonTopology> topology = cached.lock();
+    if (!topology || topology->GetVersion() != skeleton->get_version() || topology->GetBoneCount() != skeleton->get_bone_count())
+    {
+        topology = std::make_shared<SkeletonTopology>(skeleton);
+        cached = topology;
+    }
+
+    // remove entries of destroyed skeletons
+    for (auto it = cache.begin(); it != cache.end();)
+    {
+        it = it->second.expired() ? cache.erase(it) : std::next(it);
+    }
+    return topology;
+}
+
+SkeletonTopology::SkeletonTopology(Skeleton3D* skeleton)
+    : m_version(skeleton->get_version())
+{
+    int32_t boneCount = skeleton->get_bone_count();
+    m_parents.resize(boneCount, -1);
+    m_children.resize(boneCount);
+    m_names.resize(boneCount);
+    m_rests.resize(boneCount);
+
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        m_parents[bone] = skeleton->get_bone_parent(bone);
+        m_names[bone]   = skeleton->get_bone_name(bone);
+        m_rests[bone]   = skeleton->get_bone_rest(bone);
+        m_boneIndices.insert(m_names[bone], bone);
+
+        const PackedInt32Array children = skeleton->get_bone_children(bone);
+        m_children[bone].assign(children.ptr(), children.ptr() + children.size());
+    }
+
+    // breadth first from roots, indices of children are not guaranteed to be greater than the index of the parent
+    m_processOrder.reserve(boneCount);
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        if (m_parents[bone] < 0)
+        {
+            m_processOrder.emplace_back(bone);
+        }
+    }
+    for (size_t i = 0; i < m_processOrder.size(); ++i)
+    {
+        const auto& children = m_children[m_processOrder[i]];
+        m_processOrder.insert(m_processOrder.end(), children.begin(), children.end());
+    }
+
+    // FNV-1a over bone names and parents
+    m_hash = 14695981039346656037ull;
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        for (uint64_t value : {(uint64_t)m_names[bone].hash(), (uint64_t)(m_parents[bone] + 1)})
+        {
+            m_hash = (m_hash ^ value) * 1099511628211ull;
+        }
+    }
+
+    // rests are hashed separately, lengths of bones of the compiled rig depend on them
+    m_restHash = 14695981039346656037ull;
+    for (const Transform3D& rest : m_rests)
+    {
+        const real_t values[] = {
+            rest.basis.rows[0].x, rest.basis.rows[0].y, rest.basis.rows[0].z,
+            rest.basis.rows[1].x, rest.basis.rows[1].y, rest.basis.rows[1].z,
+            rest.basis.rows[2].x, rest.basis.rows[2].y, rest.basis.rows[2].z,
+            rest.origin.x, rest.origin.y, rest.origin.z,
+        };
+        for (real_t value : values)
+        {
+            uint64_t bits = 0;
+            std::memcpy(&bits, &value, sizeof(value));
+            m_restHash = (m_restHash ^ bits) * 1099511628211ull;
+        }
+    }
+
+    BuildHints();
+}
+
+int32_t SkeletonTopology::FindBone(const String& name) const
+{
+    const int32_t* bone = m_boneIndices.getptr(name);
+    return bone ? *bone : -1;
+}
+
+void SkeletonTopology::BuildHints()
+{
+    int32_t boneCount = GetBoneCount();
+    m_ancestorsHints.resize(boneCount);
+    m_descendantsHints.resize(boneCount);
+
+    // the same list as Skeleton3D::get_concatenated_bone_names provides
+    PackedStringArray names;
+    for (const String& name : m_names)
+    {
+        names.push_back(name);
+    }
+    m_namesHint = String(",").join(names);
+
+    // collect bones in the order of depth first traversal, parents always go before their children
+    std::vector<int32_t> order;
+    std::vector<int32_t> boneStack;
+    order.reserve(boneCount);
+    for (int32_t bone = 0; bone < boneCount; ++bone)
+    {
+        if (m_parents[bone] < 0)
+        {
+            boneStack.emplace_back(bone);
+        }
+    }
+    while (!boneStack.empty())
+    {
+        int32_t bone = boneStack.back();
+        boneStack.pop_back();
+        order.emplace_back(bone);
+        boneStack.insert(boneStack.end(), m_children[bone].begin(), m_children[bone].end());
+    }
+
+    // list of all parent bones from the skeleton root to the bone (including)
+    for (int32_t bone : order)
+    {
+        int32_t parent = m_parents[bone];
+        m_ancestorsHints[bone] = (parent >= 0 ? m_ancestorsHints[parent] : String()) + m_names[bone] + ",";
+    }
+
+    // list of all child bones from the bone (including) to all branch leaves, children are processed first
+    for (auto bone = order.rbegin(); bone != order.rend(); ++bone)
+    {
+        String hint = m_names[*bone] + ",";
+        const auto& children = m_children[*bone];
+        for (auto child = children.rbegin(); child != children.rend(); ++child)
+        {
+            hint += m_descendantsHints[*child];
+        }
+        m_descendantsHints[*bone] = hint;
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <godot_cpp/classes/skeleton3d.hpp>
+#include <godot_cpp/templates/hash_map.hpp>
+#include <godot_cpp/variant/string.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace godot
+{
+
+/// @brief Cached bone hierarchy of the skeleton. The cache is shared by all objects that work with the same skeleton
+/// and rebuilt when the skeleton reports the change of its bones.
+class SkeletonTopology
+{
+public:
+    // Returns actual topology of the skeleton, rebuilds the cache if the skeleton has changed since the last call
+    static std::shared_ptr<const SkeletonTopology> Get(Skeleton3D* skeleton);
+
+    uint64_t GetVersion() const                                     { return m_version;                 }
+    // hash of bone names and hierarchy, skeletons of the same type have the same hash
+    uint64_t GetHash() const                                        { return m_hash;                    }
+    // hash of rest transforms of bones, skeletons of the same type with different proportions have different hashes
+    uint64_t GetRestHash() const                                    { return m_restHash;                }
+    int32_t GetBoneCount() const                                    { return (int32_t)m_parents.size(); }
+
+    int32_t FindBone(const String& name) const;
+    int32_t GetParent(int32_t bone) const                           { return m_parents[bone];           }
+    const std::vector<int32_t>& GetChildren(int32_t bone) const     { return m_children[bone];          }
+    const String& GetBoneName(int32_t bone) const                   { return m_names[bone];             }
+    const Transform3D& GetRest(int32_t bone) const                  { return m_rests[bone];             }
+    // all bones of the skeleton, every parent goes before its children
+    const std::vector<int32_t>& GetProcessOrder() const             { return m_processOrder;            }
+
+    // Editor hints: all bones of the skeleton, bones from the skeleton root to the bone and all bones of the bone subtree
+    const String& GetBoneNamesHint() const                          { return m_namesHint;               }
+    const String& GetAncestorsHint(int32_t bone) const              { return m_ancestorsHints[bone];    }
+    const String& GetDescendantsHint(int32_t bone) const            { return m_descendantsHints[bone];  }
+
+    explicit SkeletonTopology(Skeleton3D* skeleton);
+
+private:
+    void BuildHints();
+
+    uint64_t                            m_version = 0;
+    uint64_t                            m_hash    = 0;
+    uint64_t                            m_restHash = 0;
+
+    std::vector<int32_t>                m_parents;
+    std::vector<std::vector<int32_t>>   m_children;
+    std::vector<String>                 m_names;
+    std::vector<Transform3D>            m_rests;
+    std::vector<int32_t>                m_processOrder;
+    HashMap<String, int32_t>            m_boneIndices;
+
+    String                              m_namesHint;
+    std::vector<String>                 m_ancestorsHints;
+    std::vector<String>                 m_descendantsHints;
+};
+
+}
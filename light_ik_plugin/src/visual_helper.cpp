@@ -6,13 +6,14 @@
 #include <godot_cpp/variant/vector3.hpp>
 #include <godot_cpp/variant/quaternion.hpp>
 
-#include <godot_cpp/classes/immediate_mesh.hpp>
+#include <godot_cpp/classes/array_mesh.hpp>
+#include <godot_cpp/classes/multi_mesh.hpp>
+#include <godot_cpp/classes/multi_mesh_instance3d.hpp>
 #include <godot_cpp/classes/standard_material3d.hpp>
 
 #include <glm/glm.hpp>
 #include <glm/ext/scalar_constants.hpp>
 
-#include <array>
 
 namespace godot
 {
@@ -25,6 +26,8 @@ inline Vector3 grad2rad(const Vector3 angles)
 VisualHelper::VisualHelper()
 {
     m_helpersGeometry.instantiate();
+    // vertices are updated in place, so the bounds of the mesh can't be calculated from the initial geometry
+    m_helpersGeometry->set_custom_aabb(AABB(Vector3(-1e4, -1e4, -1e4), Vector3(2e4, 2e4, 2e4)));
     set_cast_shadows_setting(GeometryInstance3D::ShadowCastingSetting::SHADOW_CASTING_SETTING_OFF);
 
     MakeMaterial(m_targetLineMaterial,      Color::hex(0xFFaa55FF));
@@ -36,6 +39,28 @@ VisualHelper::VisualHelper()
     MakeMaterial(m_jointMarkerMaterials[0], Color::hex(0xFF2222FF));
     MakeMaterial(m_jointMarkerMaterials[1], Color::hex(0x22FF22FF));
     MakeMaterial(m_jointMarkerMaterials[2], Color::hex(0x2222FFFF));
+
+    m_batches[BatchTargetLines] = GeometryBatch{m_targetLineMaterial,       Mesh::PRIMITIVE_LINES};
+    m_batches[BatchChainLines]  = GeometryBatch{m_chainLineMaterial,        Mesh::PRIMITIVE_LINES};
+    m_batches[BatchEndLines]    = GeometryBatch{m_endMarkerMaterial,        Mesh::PRIMITIVE_LINES};
+    m_batches[BatchJointX]      = GeometryBatch{m_jointMarkerMaterials[0],  Mesh::PRIMITIVE_TRIANGLES};
+    m_batches[BatchJointY]      = GeometryBatch{m_jointMarkerMaterials[1],  Mesh::PRIMITIVE_TRIANGLES};
+    m_batches[BatchJointZ]      = GeometryBatch{m_jointMarkerMaterials[2],  Mesh::PRIMITIVE_TRIANGLES};
+
+    // shapes of markers in the unit scale, the size of the marker is set by the transform of the instance
+    std::vector<Vector3> circleVertices;
+    for (size_t i = 0; i <= m_pointsPerMarker; ++i)
+    {
+        circleVertices.emplace_back(Vector3{sinf(2 * Math_PI * i/(float)m_pointsPerMarker), 0, cosf(2 * Math_PI * i/(float)m_pointsPerMarker)});
+    }
+    std::vector<Vector3> arrowVertices = {Vector3{0, -1, 0}, {0.5, -1, 0}, {0, 0, 0}, {-0.5, -1, 0}, {0, -1, 0}, {0, -1, 0.5}, {0, 0, 0}, {0, -1, -0.5}, {0,-1,0}};
+    std::vector<Vector3> crossVertices = {Vector3{0, 0, 0}, {1, 0, 0}, {0, 0, 0}, {-1, 0, 0}, 
+                                                {0, 0, 0}, {0, 1, 0}, {0, 0, 0}, {0, -1, 0},
+                                                {0, 0, 0}, {0, 0, 1}, {0, 0, 0}, {0, 0, -1}};
+
+    InitMarker(m_markers[MarkerStart],  circleVertices, m_startMarkerMaterial);
+    InitMarker(m_markers[MarkerEnd],    arrowVertices,  m_endMarkerMaterial);
+    InitMarker(m_markers[MarkerTarget], crossVertices,  m_targetMarkerMaterial);
 }
 
 VisualHelper::~VisualHelper()
@@ -49,11 +74,20 @@ void VisualHelper::_ready()
 
 void VisualHelper::_process(double delta)
 {
-    if (!is_node_ready())
+    if (!is_node_ready() || m_version == m_builtVersion)
     {
         return;
     }
-    m_helpersGeometry->clear_surfaces();
+    m_builtVersion = m_version;
+
+    for (auto& batch : m_batches)
+    {
+        batch.vertices.clear();
+    }
+    for (auto& marker : m_markers)
+    {
+        marker.transforms.clear();
+    }
 
     if (m_enabled)
     {
@@ -62,7 +96,7 @@ void VisualHelper::_process(double delta)
         {
             assert(chain.chain.size() > 1);
             // Draw the chain
-            DrawLine(chain.chain, m_chainLineMaterial);
+            DrawLine(chain.chain, m_batches[BatchChainLines]);
 
             // Add major chain markers to the beginning and the end of the chain
             DrawStartMarker(chain.start);
@@ -72,10 +106,10 @@ void VisualHelper::_process(double delta)
             DrawTargetMarker(Transform3D(chain.chain.back().basis, chain.target));
 
             // Draw line between the tip and the target of the chain
-            DrawDashedLine(chain.chain.back().origin, chain.target, m_targetLineMaterial);
+            DrawDashedLine(chain.chain.back().origin, chain.target, m_batches[BatchTargetLines]);
 
             // Draw line between the root and the tip of the chain
-            DrawDashedLine(chain.start.origin, chain.chain.back().origin, m_endMarkerMaterial);
+            DrawDashedLine(chain.start.origin, chain.chain.back().origin, m_batches[BatchEndLines]);
         }
 
         // visualize joint constraints
@@ -85,11 +119,17 @@ void VisualHelper::_process(double delta)
             Vector3 minAngles = grad2rad(constraint.minAngles);
             Vector3 maxAngles = grad2rad(constraint.maxAngles);
 
-            DrawArc(constraint.position, radius, minAngles.x, maxAngles.x, Vector3(1, 0, 0), Vector3(0, 1, 0), m_jointMarkerMaterials[0]);
-            DrawArc(constraint.position, radius, minAngles.y, maxAngles.y, Vector3(0, 1, 0), Vector3(0, 0, 1), m_jointMarkerMaterials[1]);
-            DrawArc(constraint.position, radius, minAngles.z, maxAngles.z, Vector3(0, 0, 1), Vector3(0, 1, 0), m_jointMarkerMaterials[2]);
+            DrawArc(constraint.position, radius, minAngles.x, maxAngles.x, Vector3(1, 0, 0), Vector3(0, 1, 0), m_batches[BatchJointX]);
+            DrawArc(constraint.position, radius, minAngles.y, maxAngles.y, Vector3(0, 1, 0), Vector3(0, 0, 1), m_batches[BatchJointY]);
+            DrawArc(constraint.position, radius, minAngles.z, maxAngles.z, Vector3(0, 0, 1), Vector3(0, 1, 0), m_batches[BatchJointZ]);
         }
     }
+
+    UploadGeometry();
+    for (auto& marker : m_markers)
+    {
+        UploadMarker(marker);
+    }
 }
 
 void VisualHelper::AddChain(const ChainVisualData& visualData)
@@ -104,38 +144,23 @@ void VisualHelper::AddBoneConstraint(const BoneInfo& constraintData)
 
 void VisualHelper::DrawStartMarker(const Transform3D& point)
 {
-    static std::vector<Vector3> circularVertices;
-    if (circularVertices.empty())
-    {
-        for (size_t i = 0; i < m_pointsPerMarker; ++i)
-        {
-            circularVertices.emplace_back(Vector3{sinf(2 * Math_PI * i/(float)m_pointsPerMarker), 0, cosf(2 * Math_PI * i/(float)m_pointsPerMarker)});
-        }
-        circularVertices.push_back(circularVertices.front());
-    }
-
-    DrawLineShape(circularVertices, point, m_radiusRoot, m_startMarkerMaterial);
+    m_markers[MarkerStart].transforms.emplace_back(point.scaled_local(Vector3(m_radiusRoot, m_radiusRoot, m_radiusRoot)));
 }
 
 void VisualHelper::DrawEndMarker(const Transform3D& position, const Transform3D& orientation)
 {
-    static std::vector<Vector3> arrowVertices = {Vector3{0, -1, 0}, {0.5, -1, 0}, {0, 0, 0}, {-0.5, -1, 0}, {0, -1, 0}, {0, -1, 0.5}, {0, 0, 0}, {0, -1, -0.5}, {0,-1,0}};
-
     //the transform of the tip consists of position of the last joint and orientation of pre-last bone
     Transform3D tipPosition = Transform3D(orientation.basis, position.origin);
-    DrawLineShape(arrowVertices, tipPosition, m_radiusRoot, m_endMarkerMaterial);
+    m_markers[MarkerEnd].transforms.emplace_back(tipPosition.scaled_local(Vector3(m_radiusRoot, m_radiusRoot, m_radiusRoot)));
 }
 
 void VisualHelper::DrawTargetMarker(const Transform3D& point)
 {
-    static std::vector<Vector3> rectangleVertices = {Vector3{0, 0, 0}, {1, 0, 0}, {0, 0, 0}, {-1, 0, 0}, 
-                                                            {0, 0, 0}, {0, 1, 0}, {0, 0, 0}, {0, -1, 0},
-                                                            {0, 0, 0}, {0, 0, 1}, {0, 0, 0}, {0, 0, -1}};
-
-    DrawLineShape(rectangleVertices, point, m_radiusRoot/2.0, m_targetMarkerMaterial);
+    real_t scale = m_radiusRoot / 2.0;
+    m_markers[MarkerTarget].transforms.emplace_back(point.scaled_local(Vector3(scale, scale, scale)));
 }
 
-void VisualHelper::DrawDashedLine(const Vector3& from, const Vector3& to, Ref<StandardMaterial3D>& material)
+void VisualHelper::DrawDashedLine(const Vector3& from, const Vector3& to, GeometryBatch& batch)
 {
     // setup the material
     Vector3 direction = to - from;
@@ -147,58 +172,159 @@ void VisualHelper::DrawDashedLine(const Vector3& from, const Vector3& to, Ref<St
     constexpr float DashedLineDashSize = 0.2f;
     size_t steps = glm::min(DashedLineMaxSteps, (size_t)(distance / DashedLineDashSize + 1));
     float dashSize = distance / (steps - 0.5f);
-    m_helpersGeometry->surface_begin(Mesh::PrimitiveType::PRIMITIVE_LINES, material);
     for (size_t i = 0; i < steps; ++i)
     {
-        m_helpersGeometry->surface_add_vertex(from + direction * dashSize * i);
-        m_helpersGeometry->surface_add_vertex(from + direction * glm::min(dashSize * i + dashSize/2.f, distance));
+        batch.vertices.emplace_back(from + direction * dashSize * i);
+        batch.vertices.emplace_back(from + direction * glm::min(dashSize * i + dashSize/2.f, distance));
+    }
+}
+
+void VisualHelper::DrawLine(const std::vector<Transform3D>& line, GeometryBatch& batch)
+{
+    // the strip is stored as separate segments to share the surface with other lines
+    for (size_t i = 1; i < line.size(); ++i)
+    {
+        batch.vertices.emplace_back(line[i - 1].origin);
+        batch.vertices.emplace_back(line[i].origin);
     }
-    m_helpersGeometry->surface_end();
 }
 
-void VisualHelper::DrawLine(const std::vector<Transform3D>& line, Ref<StandardMaterial3D>& material)
+void VisualHelper::DrawArc(const Transform3D& center, float radius, float minAngle, float maxAngle, Vector3 axis, Vector3 direction, GeometryBatch& batch)
 {
-    m_helpersGeometry->surface_begin(Mesh::PrimitiveType::PRIMITIVE_LINE_STRIP, material);
-    for (const auto& vertex : line)
+    // the sector is the fan of triangles around the center of the joint
+    Vector3 minAxis         = direction.rotated(axis, minAngle);
+    float step              = (maxAngle - minAngle)/m_pointsPerMarker;
+    Vector3 origin          = center.origin;
+    Vector3 previous        = center.xform(radius * minAxis);
+    for (size_t i = 1; i <= m_pointsPerMarker; ++i)
     {
-        m_helpersGeometry->surface_add_vertex(vertex.origin);
+        Vector3 point = center.xform(radius * minAxis.rotated(axis, step * i));
+        batch.vertices.emplace_back(origin);
+        batch.vertices.emplace_back(previous);
+        batch.vertices.emplace_back(point);
+        previous = point;
     }
-    m_helpersGeometry->surface_end();
 }
 
-void VisualHelper::DrawLineShape(const std::vector<Vector3>& shape, const Transform3D& position, float scale, Ref<StandardMaterial3D>& material)
+void VisualHelper::InitMarker(MarkerBatch& marker, const std::vector<Vector3>& shape, Ref<StandardMaterial3D>& material)
 {
-    m_helpersGeometry->surface_begin(Mesh::PrimitiveType::PRIMITIVE_LINE_STRIP, material);
+    PackedVector3Array vertices;
     for (const auto& vertex : shape)
     {
-        m_helpersGeometry->surface_add_vertex(position.xform(scale * vertex));
+        vertices.push_back(vertex);
     }
-    m_helpersGeometry->surface_end();
+    Array arrays;
+    arrays.resize(Mesh::ARRAY_MAX);
+    arrays[Mesh::ARRAY_VERTEX] = vertices;
+
+    Ref<ArrayMesh> mesh;
+    mesh.instantiate();
+    mesh->add_surface_from_arrays(Mesh::PRIMITIVE_LINE_STRIP, arrays);
+    mesh->surface_set_material(0, material);
+
+    marker.multimesh.instantiate();
+    marker.multimesh->set_transform_format(MultiMesh::TRANSFORM_3D);
+    marker.multimesh->set_mesh(mesh);
+
+    marker.instance = memnew(MultiMeshInstance3D);
+    marker.instance->set_multimesh(marker.multimesh);
+    marker.instance->set_cast_shadows_setting(GeometryInstance3D::ShadowCastingSetting::SHADOW_CASTING_SETTING_OFF);
+    add_child(marker.instance);
 }
 
-void VisualHelper::DrawArc(const Transform3D& center, float radius, float minAngle, float maxAngle, Vector3 axis, Vector3 direction, Ref<StandardMaterial3D>& material)
+void VisualHelper::UploadGeometry()
 {
-    Vector3 minAxis         = direction.rotated(axis, minAngle);
-    float step              = (maxAngle - minAngle)/m_pointsPerMarker;
-    std::vector<Vector3> arc = {Vector3(0,0,0), minAxis};
-    for (size_t i = 0; i < m_pointsPerMarker; ++i)
+    for (const auto& batch : m_batches)
     {
-        Vector3 point = minAxis.rotated(axis, step * i);
-        arc.emplace_back(point);
-        arc.emplace_back(Vector3(0,0,0));
+        if ((int64_t)batch.vertices.size() > batch.capacity)
+        {
+            RebuildSurfaces();
+            return;
+        }
     }
 
-    DrawShape(arc, center, radius, material, Mesh::PrimitiveType::PRIMITIVE_TRIANGLE_STRIP);
+    // Geometry fits into the surfaces, only the used part and the part used in the previous frame are updated.
+    // Unused vertices are collapsed to the single point, so degenerate primitives are not visible
+    for (int32_t surface = 0; surface < BatchCount; ++surface)
+    {
+        GeometryBatch& batch = m_batches[surface];
+        int64_t count = Math::max((int64_t)batch.vertices.size(), batch.uploaded);
+        if (count == 0)
+        {
+            continue;
+        }
+
+        m_uploadBuffer.resize(count * 3 * sizeof(float));
+        float* data = (float*)m_uploadBuffer.ptrw();
+        for (int64_t i = 0; i < count; ++i)
+        {
+            const Vector3& vertex = i < (int64_t)batch.vertices.size() ? batch.vertices[i] : Vector3();
+            data[3 * i + 0] = (float)vertex.x;
+            data[3 * i + 1] = (float)vertex.y;
+            data[3 * i + 2] = (float)vertex.z;
+        }
+        m_helpersGeometry->surface_update_vertex_region(surface, 0, m_uploadBuffer);
+        batch.uploaded = batch.vertices.size();
+    }
 }
 
-void VisualHelper::DrawShape(const std::vector<Vector3>& shape, const Transform3D& position, float scale, Ref<StandardMaterial3D>& material, Mesh::PrimitiveType primitive)
+void VisualHelper::RebuildSurfaces()
 {
-    m_helpersGeometry->surface_begin(primitive, material);
-    for (const auto& vertex : shape)
+    // Surfaces are recreated with the capacity rounded up to the power of two, so the rebuild happens rarely
+    m_helpersGeometry->clear_surfaces();
+    for (int32_t surface = 0; surface < BatchCount; ++surface)
+    {
+        GeometryBatch& batch = m_batches[surface];
+        batch.capacity = Math::max((int64_t)64, (int64_t)next_power_of_2((uint32_t)batch.vertices.size()));
+        batch.uploaded = batch.vertices.size();
+
+        PackedVector3Array vertices;
+        vertices.resize(batch.capacity);
+        Vector3* data = vertices.ptrw();
+        for (int64_t i = 0; i < batch.capacity; ++i)
+        {
+            data[i] = i < (int64_t)batch.vertices.size() ? batch.vertices[i] : Vector3();
+        }
+
+        Array arrays;
+        arrays.resize(Mesh::ARRAY_MAX);
+        arrays[Mesh::ARRAY_VERTEX] = vertices;
+        m_helpersGeometry->add_surface_from_arrays(batch.primitive, arrays, Array(), Dictionary(), Mesh::ARRAY_FLAG_USE_DYNAMIC_UPDATE);
+        m_helpersGeometry->surface_set_material(surface, batch.material);
+    }
+}
+
+void VisualHelper::UploadMarker(MarkerBatch& marker)
+{
+    int32_t count = (int32_t)marker.transforms.size();
+    if (count > marker.multimesh->get_instance_count())
+    {
+        // changing of the instance count drops the data, so it grows by the power of two
+        int32_t capacity = Math::max(16, (int32_t)next_power_of_2((uint32_t)count));
+        marker.multimesh->set_instance_count(capacity);
+        marker.buffer.resize(capacity * 12);
+    }
+    if (count == 0 && marker.multimesh->get_visible_instance_count() == 0)
     {
-        m_helpersGeometry->surface_add_vertex(position.xform(scale * vertex));
+        return;
+    }
+
+    // the buffer holds rows of 3x4 matrices
+    float* data = marker.buffer.ptrw();
+    for (int32_t i = 0; i < count; ++i)
+    {
+        const Transform3D& transform = marker.transforms[i];
+        float* row = data + 12 * i;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            row[4 * axis + 0] = (float)transform.basis.rows[axis].x;
+            row[4 * axis + 1] = (float)transform.basis.rows[axis].y;
+            row[4 * axis + 2] = (float)transform.basis.rows[axis].z;
+            row[4 * axis + 3] = (float)transform.origin[axis];
+        }
     }
-    m_helpersGeometry->surface_end();
+    marker.multimesh->set_buffer(marker.buffer);
+    marker.multimesh->set_visible_instance_count(count);
 }
 
 void VisualHelper::MakeMaterial(Ref<StandardMaterial3D>& material, Color color)
@@ -9,7 +9,9 @@
 namespace godot
 {
 
-class ImmediateMesh;
+class ArrayMesh;
+class MultiMesh;
+class MultiMeshInstance3D;
 class StandardMaterial3D;
 
 
@@ -34,10 +36,10 @@ public: // godot overrides
         Vector3 target;
         bool hasTarget = false;
     };
-    void ResetChainData()                                   { m_chainVisualData.clear();        }
+    void ResetChainData()                                   { m_chainVisualData.clear(); ++m_version;           }
     void AddChain(const ChainVisualData& visualData);
 
-    
+
     struct BoneInfo
     {
         Transform3D position;
@@ -49,33 +51,75 @@ public: // godot overrides
         real_t      flexibility = 1;
         bool        constrained = false;
     };
-    void ResetBoneConstraintsData()                         { m_boneConstraintData.clear();     }
+    void ResetBoneConstraintsData()                         { m_boneConstraintData.clear(); ++m_version;        }
     void AddBoneConstraint(const BoneInfo& constraintData);
 
-    void SetRootMarkerRadius(float markerRadius)            { m_radiusRoot = markerRadius;      }
-    float GetRootMarkerRadius() const                       { return m_radiusRoot;              }
+    void SetRootMarkerRadius(float markerRadius)            { m_radiusRoot = markerRadius; ++m_version;         }
+    float GetRootMarkerRadius() const                       { return m_radiusRoot;                              }
 
-    void SetConstraintMarkerRadius(float markerRadius)      { m_radiusJoint = markerRadius;     }
-    float GetConstraintMarkerRadius() const                 { return m_radiusJoint;             }
+    void SetConstraintMarkerRadius(float markerRadius)      { m_radiusJoint = markerRadius; ++m_version;        }
+    float GetConstraintMarkerRadius() const                 { return m_radiusJoint;                             }
 
-    void Enable(bool enabled)                               { m_enabled = enabled;              }
+    void Enable(bool enabled)                               { m_enabled = enabled; ++m_version;                 }
 private:
+    // All primitives of the same material are collected to one surface of the persistent mesh.
+    // The surface is allocated with extra capacity and updated in place while the geometry fits into it
+    enum GeometryBatchId
+    {
+        BatchTargetLines,
+        BatchChainLines,
+        BatchEndLines,
+        BatchJointX,
+        BatchJointY,
+        BatchJointZ,
+        BatchCount
+    };
+    struct GeometryBatch
+    {
+        Ref<StandardMaterial3D> material;
+        Mesh::PrimitiveType     primitive   = Mesh::PRIMITIVE_LINES;
+        std::vector<Vector3>    vertices;
+        int64_t                 capacity    = 0;
+        // number of vertices uploaded last time, the rest of the surface is already degenerate
+        int64_t                 uploaded    = 0;
+    };
+
+    // Markers of the same shape are instanced
+    enum MarkerBatchId
+    {
+        MarkerStart,
+        MarkerEnd,
+        MarkerTarget,
+        MarkerCount
+    };
+    struct MarkerBatch
+    {
+        MultiMeshInstance3D*        instance    = nullptr;
+        Ref<MultiMesh>              multimesh;
+        std::vector<Transform3D>    transforms;
+        PackedFloat32Array          buffer;
+    };
 
     void DrawStartMarker(const Transform3D& point);
     void DrawEndMarker(const Transform3D& position, const Transform3D& orientation);
     void DrawTargetMarker(const Transform3D& position);
 
-    void DrawDashedLine(const Vector3& from, const Vector3& to, Ref<StandardMaterial3D>& material);
-    void DrawLine(const std::vector<Transform3D>& points, Ref<StandardMaterial3D>& material);
-    void DrawLineShape(const std::vector<Vector3>& shape, const Transform3D& position, float scale, Ref<StandardMaterial3D>& material);
-    void DrawShape(const std::vector<Vector3>& shape, const Transform3D& position, float scale, Ref<StandardMaterial3D>& material, Mesh::PrimitiveType primitive);
+    void DrawDashedLine(const Vector3& from, const Vector3& to, GeometryBatch& batch);
+    void DrawLine(const std::vector<Transform3D>& points, GeometryBatch& batch);
+    void DrawArc(const Transform3D& center, float radius, float minAngle, float maxAngle, Vector3 axis, Vector3 direction, GeometryBatch& batch);
 
-    void DrawArc(const Transform3D& center, float radius, float minAngle, float maxAngle, Vector3 axis, Vector3 direction, Ref<StandardMaterial3D>& material);
+    void InitMarker(MarkerBatch& marker, const std::vector<Vector3>& shape, Ref<StandardMaterial3D>& material);
+    void UploadGeometry();
+    void RebuildSurfaces();
+    void UploadMarker(MarkerBatch& marker);
 
     void MakeMaterial(Ref<StandardMaterial3D>& material, Color color);
 
-    Ref<ImmediateMesh>              m_helpersGeometry;
-    
+    Ref<ArrayMesh>                  m_helpersGeometry;
+    GeometryBatch                   m_batches[BatchCount];
+    MarkerBatch                     m_markers[MarkerCount];
+    PackedByteArray                 m_uploadBuffer;
+
     Ref<StandardMaterial3D>         m_targetLineMaterial;
     Ref<StandardMaterial3D>         m_chainLineMaterial;
     Ref<StandardMaterial3D>         m_startMarkerMaterial;
@@ -86,9 +130,12 @@ private:
     bool                            m_enabled       = false;
     float                           m_radiusJoint   = 0.2f;
     float                           m_radiusRoot    = 0.25f;
-    
+
     std::vector<ChainVisualData>    m_chainVisualData;
     std::vector<BoneInfo>           m_boneConstraintData;
+    // version of the input data and the version the geometry was built from
+    uint64_t                        m_version           = 0;
+    uint64_t                        m_builtVersion      = UINT64_MAX;
 
     const size_t                    m_pointsPerMarker = 32;
 };
@@ -0,0 +1,117 @@
+#include "capture_reader.h"
+
+#include <cstring>
+
+namespace LightIKReplay
+{
+
+using namespace LightIKCapture;
+
+bool CaptureReader::Open(const std::string& path, std::string& error)
+{
+    m_header = nullptr;
+    if (!m_file.Open(path))
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    const FileHeader* header = reinterpret_cast<const FileHeader*>(m_file.GetData());
+    if (m_file.GetSize() < sizeof(FileHeader) || std::memcmp(header->magic, Magic, sizeof(Magic)))
+    {
+        error = path + " is not a LightIK capture";
+        return false;
+    }
+    if (header->version != Version)
+    {
+        error = "unsupported capture version " + std::to_string(header->version);
+        return false;
+    }
+
+    // solver types are stored as is, so the capture is valid only for the solver of the same configuration
+    FileHeader expected;
+    if (header->realSize != expected.realSize || header->boneDescSize != expected.boneDescSize || header->constraintSize != expected.constraintSize)
+    {
+        error = "capture is written by the solver with different types, real size " + std::to_string(header->realSize)
+              + " bytes, expected " + std::to_string(expected.realSize);
+        return false;
+    }
+
+    // the capture streamed to the file has no frames count if the application was terminated before the capture was closed,
+    // then all complete frames of the file are replayed
+    m_framesCount = header->frameCount;
+    if (m_framesCount == 0 && header->frameStride > 0 && m_file.GetSize() > header->framesOffset)
+    {
+        m_framesCount = (m_file.GetSize() - header->framesOffset) / header->frameStride;
+    }
+
+    uint64_t size = header->framesOffset + m_framesCount * header->frameStride;
+    if (header->frameStride < GetFrameStride(header->chainCount, header->boneCount, header->groupCount) || size > m_file.GetSize()
+        || header->chainsOffset + header->chainCount * sizeof(ChainRecord) > header->boneDescsOffset
+        || header->boneDescsOffset + header->boneDescCount * sizeof(LightIK::BoneDesc) > header->constraintsOffset
+        || header->constraintsOffset + header->constraintCount * sizeof(ConstraintRecord) > header->framesOffset)
+    {
+        error = path + " is corrupted";
+        return false;
+    }
+
+    // bone indices of records index the rotations of frames, so every index is checked before any frame is replayed
+    auto isBone = [header](int32_t bone) { return bone >= 0 && bone < (int32_t)header->boneCount; };
+    for (uint32_t c = 0; c < header->chainCount; ++c)
+    {
+        const ChainRecord& chain = reinterpret_cast<const ChainRecord*>(m_file.GetData() + header->chainsOffset)[c];
+        if (chain.groupIndex >= header->groupCount || (uint64_t)chain.rootChainFirst + chain.rootChainCount > header->boneDescCount
+            || (uint64_t)chain.targetChainFirst + chain.targetChainCount > header->boneDescCount
+            || !isBone(chain.startBone) || (chain.targetBone >= 0 && !isBone(chain.targetBone)))
+        {
+            error = path + " is corrupted";
+            return false;
+        }
+    }
+
+    const LightIK::BoneDesc* bones = reinterpret_cast<const LightIK::BoneDesc*>(m_file.GetData() + header->boneDescsOffset);
+    for (uint32_t b = 0; b < header->boneDescCount; ++b)
+    {
+        if (!isBone(bones[b].boneIndex))
+        {
+            error = path + " is corrupted";
+            return false;
+        }
+    }
+
+    const ConstraintRecord* constraints = reinterpret_cast<const ConstraintRecord*>(m_file.GetData() + header->constraintsOffset);
+    for (uint32_t c = 0; c < header->constraintCount; ++c)
+    {
+        if (!isBone(constraints[c].boneIndex))
+        {
+            error = path + " is corrupted";
+            return false;
+        }
+    }
+
+    m_header = header;
+    return true;
+}
+
+const ChainRecord& CaptureReader::GetChain(uint32_t index) const
+{
+    return reinterpret_cast<const ChainRecord*>(m_file.GetData() + m_header->chainsOffset)[index];
+}
+
+std::vector<LightIK::BoneDesc> CaptureReader::GetBones(uint32_t first, uint32_t count) const
+{
+    const LightIK::BoneDesc* bones = reinterpret_cast<const LightIK::BoneDesc*>(m_file.GetData() + m_header->boneDescsOffset);
+    return std::vector<LightIK::BoneDesc>(bones + first, bones + first + count);
+}
+
+const ConstraintRecord& CaptureReader::GetConstraint(uint32_t index) const
+{
+    return reinterpret_cast<const ConstraintRecord*>(m_file.GetData() + m_header->constraintsOffset)[index];
+}
+
+const FrameHeader* CaptureReader::GetFrame(uint64_t index) const
+{
+    return reinterpret_cast<const FrameHeader*>(m_file.GetData() + m_header->framesOffset + index * m_header->frameStride);
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "mapped_file.h"
+#include "capture_format.h"
+
+#include <string>
+#include <vector>
+
+namespace LightIKReplay
+{
+
+/// @brief Validates the capture written by LightIKPlugin and gives access to its sections in place
+class CaptureReader
+{
+public:
+    // returns the description of the problem if the capture cannot be replayed by this build of the solver
+    bool Open(const std::string& path, std::string& error);
+
+    const LightIKCapture::FileHeader& GetHeader() const     { return *m_header;     }
+    const LightIKCapture::ChainRecord& GetChain(uint32_t index) const;
+    std::vector<LightIK::BoneDesc> GetBones(uint32_t first, uint32_t count) const;
+    const LightIKCapture::ConstraintRecord& GetConstraint(uint32_t index) const;
+    const LightIKCapture::FrameHeader* GetFrame(uint64_t index) const;
+    uint64_t GetFramesCount() const                         { return m_framesCount; }
+
+private:
+    MappedFile                          m_file;
+    const LightIKCapture::FileHeader*   m_header        = nullptr;
+    uint64_t                            m_framesCount   = 0;
+};
+
+}
@@ -0,0 +1,511 @@
+#include "capture_reader.h"
+#include "mapped_file.h"
+
+#include "light_ik/light_ik.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace LightIKReplay;
+using namespace LightIKCapture;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+// Output rotations of the replay, used as the reference for the next runs
+//  ReplayOutputHeader
+//  float rotations[frameCount][boneCount][4]
+constexpr char ReplayOutputMagic[8] = {'L', 'I', 'K', 'R', 'E', 'P', 'L', 'Y'};
+
+struct ReplayOutputHeader
+{
+    char        magic[8]    = {};
+    uint32_t    boneCount   = 0;
+    uint32_t    reserved    = 0;
+    uint64_t    frameCount  = 0;
+};
+
+struct ReplayParameters
+{
+    std::string capturePath;
+    std::string outputPath;
+    std::string referencePath;
+    // Solver settings are taken from every captured frame, the parameters override them if set.
+    // Iterations of every solve, the limit of iterations in tolerance mode
+    size_t      iterations  = 0;
+    // 0 solves every frame from the pose the controller was created with instead of the previous solution, 1 warm starts
+    int         warmStart   = -1;
+    // distance between tips and targets at which the solve stops, the same as the tolerance of the plugin. 0 runs all iterations
+    double      solveTolerance = -1;
+    // maximal angle in radians between the output and the reference rotations
+    double      tolerance   = 1e-4;
+};
+
+// Rotation of the bone produced by the last solve of the group
+struct BoneRotation
+{
+    int32_t             boneIndex   = -1;
+    LightIK::Quaternion rotation;
+};
+
+// Controller of the group, built the same way the plugin builds it
+struct ReplayGroup
+{
+    std::unique_ptr<LightIK::LightIK>       controller;
+    // index of the first chain record of the group and number of its chains
+    uint32_t                                firstChain  = 0;
+    uint32_t                                chainCount  = 0;
+    // targets and solvers of the chains of the current controller, links have no target
+    std::vector<LightIK::TargetPosition*>   targets;
+    std::vector<size_t>                     solverIds;
+    // sorted list of all bones the chains of the group depend on
+    std::vector<int32_t>                    bones;
+    // the output of groups that are not solved in the frame is the solution of their last solve
+    std::vector<BoneRotation>               solution;
+};
+
+struct ReplayStats
+{
+    uint64_t    solvedGroups        = 0;
+    uint64_t    reseededGroups      = 0;
+    uint64_t    iterations          = 0;
+};
+
+struct DiffResult
+{
+    uint64_t    comparedFrames      = 0;
+    uint64_t    mismatchedFrames    = 0;
+    int64_t     firstMismatchFrame  = -1;
+    int32_t     firstMismatchBone   = -1;
+    double      maxAngleError       = 0;
+};
+
+// Groups are split by the chain records, controllers are created by the first frame from its pose
+std::vector<ReplayGroup> BuildGroups(const CaptureReader& capture)
+{
+    const FileHeader& header = capture.GetHeader();
+    std::vector<ReplayGroup> groups;
+    for (uint32_t c = 0; c < header.chainCount; ++c)
+    {
+        const ChainRecord& chain = capture.GetChain(c);
+        // chains are stored group by group
+        if (groups.empty() || chain.groupIndex != capture.GetChain(groups.back().firstChain).groupIndex)
+        {
+            groups.emplace_back();
+            groups.back().firstChain = c;
+        }
+
+        ReplayGroup& group = groups.back();
+        ++group.chainCount;
+        for (const auto& range : {std::make_pair(chain.rootChainFirst, chain.rootChainCount), std::make_pair(chain.targetChainFirst, chain.targetChainCount)})
+        {
+            for (const LightIK::BoneDesc& bone : capture.GetBones(range.first, range.second))
+            {
+                group.bones.emplace_back(bone.boneIndex);
+            }
+        }
+    }
+
+    for (ReplayGroup& group : groups)
+    {
+        std::sort(group.bones.begin(), group.bones.end());
+        group.bones.erase(std::unique(group.bones.begin(), group.bones.end()), group.bones.end());
+    }
+    return groups;
+}
+
+// Constraints by the bone, the capture has at most one constraint per bone
+std::vector<int32_t> GetBoneConstraints(const CaptureReader& capture)
+{
+    const FileHeader& header = capture.GetHeader();
+    std::vector<int32_t> boneConstraints(header.boneCount, -1);
+    for (uint32_t c = 0; c < header.constraintCount; ++c)
+    {
+        int32_t bone = capture.GetConstraint(c).boneIndex;
+        if (bone >= 0 && bone < (int32_t)header.boneCount)
+        {
+            boneConstraints[bone] = (int32_t)c;
+        }
+    }
+    return boneConstraints;
+}
+
+// Creates the controller of the group from the captured chains with rotations of the input pose, 
+// the same way the plugin reseeds its controllers from the pose of the frame
+void CreateController(ReplayGroup& group, const CaptureReader& capture, const std::vector<int32_t>& boneConstraints, const float* rotations)
+{
+    auto seed = [&capture, rotations](uint32_t first, uint32_t count)
+    {
+        std::vector<LightIK::BoneDesc> bones = capture.GetBones(first, count);
+        for (LightIK::BoneDesc& bone : bones)
+        {
+            const float* rotation = rotations + bone.boneIndex * 4;
+            bone.rotation = LightIK::Quaternion{(LightIK::real)rotation[3], (LightIK::real)rotation[0], (LightIK::real)rotation[1], (LightIK::real)rotation[2]};
+        }
+        return bones;
+    };
+
+    group.controller = std::make_unique<LightIK::LightIK>(capture.GetHeader().boneCount);
+    group.targets.clear();
+    group.solverIds.clear();
+    for (uint32_t c = group.firstChain; c < group.firstChain + group.chainCount; ++c)
+    {
+        const ChainRecord& chain = capture.GetChain(c);
+        std::vector<LightIK::BoneDesc> rootChain = seed(chain.rootChainFirst, chain.rootChainCount);
+        if (chain.targetBone < 0)
+        {
+            LightIK::TargetPosition& target = group.controller->CreateTarget();
+            group.controller->CreateIKChain(rootChain, chain.startBone, 0, target);
+            group.targets.emplace_back(&target);
+        }
+        else
+        {
+            group.controller->CreatePassiveChain(seed(chain.targetChainFirst, chain.targetChainCount));
+            group.controller->CreateIKLink(rootChain, chain.startBone, chain.targetBone);
+            group.targets.emplace_back(nullptr);
+        }
+        group.solverIds.emplace_back(group.controller->GetSolversCount() - 1);
+    }
+
+    // only controllers that process the bone need the constraint
+    for (int32_t bone : group.bones)
+    {
+        if (boneConstraints[bone] >= 0)
+        {
+            group.controller->SetConstraint(bone, LightIK::Constraints(capture.GetConstraint(boneConstraints[bone]).constraint));
+        }
+    }
+}
+
+bool IsConverged(const ReplayGroup& group, LightIK::real toleranceSquared)
+{
+    for (size_t solverId : group.solverIds)
+    {
+        LightIK::Vector tip    = group.controller->GetTipPosition(solverId);
+        LightIK::Vector target = group.controller->GetTargetPosition(solverId);
+        LightIK::real dx = tip.x - target.x;
+        LightIK::real dy = tip.y - target.y;
+        LightIK::real dz = tip.z - target.z;
+        if (dx * dx + dy * dy + dz * dz > toleranceSquared)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Solves groups the plugin solved in the frame and writes the input pose with rotations of the solutions applied to the output,
+// returns the solve time
+double ReplayFrame(std::vector<ReplayGroup>& groups, const CaptureReader& capture, const std::vector<int32_t>& boneConstraints,
+                   const FrameHeader* frame, const ReplayParameters& parameters, ReplayStats& stats, float* output)
+{
+    const FileHeader& header = capture.GetHeader();
+    const uint32_t* solved   = GetFrameSolvedMask(frame);
+    const uint32_t* reseeded = GetFrameReseededMask(frame, header.groupCount);
+    const float* targets     = GetFrameTargets(frame, header.groupCount);
+    const float* rotations   = GetFrameRotations(frame, header.groupCount, header.chainCount);
+    SolverSettings settings = frame->settings;
+    settings.iterations = parameters.iterations > 0 ? (uint32_t)parameters.iterations : std::max(settings.iterations, 1u);
+    settings.tolerance  = parameters.solveTolerance >= 0 ? (float)parameters.solveTolerance : settings.tolerance;
+    settings.warmStart  = parameters.warmStart >= 0 ? (uint32_t)parameters.warmStart : settings.warmStart;
+    LightIK::real toleranceSquared = (LightIK::real)settings.tolerance * (LightIK::real)settings.tolerance;
+
+    auto solveStart = Clock::now();
+    for (uint32_t g = 0; g < groups.size(); ++g)
+    {
+        ReplayGroup& group = groups[g];
+        // controllers kept by the plugin from before the capture started are approximated by the pose of the first frame
+        bool reseed = IsGroupSet(reseeded, g);
+        if (!group.controller || reseed)
+        {
+            CreateController(group, capture, boneConstraints, rotations);
+        }
+        stats.reseededGroups += reseed ? 1 : 0;
+        if (!IsGroupSet(solved, g))
+        {
+            continue;
+        }
+
+        for (size_t c = 0; c < group.targets.size(); ++c)
+        {
+            if (group.targets[c])
+            {
+                const float* target = targets + (group.firstChain + c) * 3;
+                group.targets[c]->SetPosition(LightIK::Vector{(LightIK::real)target[0], (LightIK::real)target[1], (LightIK::real)target[2]});
+            }
+        }
+        if (!settings.warmStart)
+        {
+            group.controller->ResetPose();
+        }
+
+        if (settings.tolerance > 0)
+        {
+            // the same loop as the plugin runs in tolerance mode: iteration by iteration until all chains reached their targets
+            size_t iterations = 0;
+            bool converged = false;
+            while (!converged && iterations < settings.iterations)
+            {
+                group.controller->Update(1);
+                ++iterations;
+                converged = IsConverged(group, toleranceSquared);
+            }
+            stats.iterations += iterations;
+        }
+        else
+        {
+            group.controller->Update(settings.iterations);
+            stats.iterations += settings.iterations;
+        }
+
+        group.solution.clear();
+        const auto& deltas = group.controller->GetDeltaRotations();
+        for (int32_t index : group.bones)
+        {
+            if (deltas[index])
+            {
+                group.solution.emplace_back(BoneRotation{index, *deltas[index]});
+            }
+        }
+        ++stats.solvedGroups;
+    }
+    double solveTime = std::chrono::duration<double, std::nano>(Clock::now() - solveStart).count();
+
+    // the solver replaces rotations of the bones it modified, the rest of the pose is left as is
+    std::memcpy(output, rotations, header.boneCount * 4 * sizeof(float));
+    for (const ReplayGroup& group : groups)
+    {
+        for (const BoneRotation& bone : group.solution)
+        {
+            float* rotation = output + bone.boneIndex * 4;
+            rotation[0] = (float)bone.rotation.x;
+            rotation[1] = (float)bone.rotation.y;
+            rotation[2] = (float)bone.rotation.z;
+            rotation[3] = (float)bone.rotation.w;
+        }
+    }
+    return solveTime;
+}
+
+double GetAngle(const float* a, const float* b)
+{
+    double dot = std::abs((double)a[0] * b[0] + (double)a[1] * b[1] + (double)a[2] * b[2] + (double)a[3] * b[3]);
+    return 2.0 * std::acos(std::min(dot, 1.0));
+}
+
+void CompareFrame(const float* output, const float* reference, uint32_t boneCount, uint64_t frameIndex, double tolerance, DiffResult& diff)
+{
+    bool mismatched = false;
+    for (uint32_t bone = 0; bone < boneCount; ++bone)
+    {
+        double angle = GetAngle(output + bone * 4, reference + bone * 4);
+        diff.maxAngleError = std::max(diff.maxAngleError, angle);
+        if (angle > tolerance && !mismatched)
+        {
+            mismatched = true;
+            if (diff.firstMismatchFrame < 0)
+            {
+                diff.firstMismatchFrame = (int64_t)frameIndex;
+                diff.firstMismatchBone  = (int32_t)bone;
+            }
+        }
+    }
+    ++diff.comparedFrames;
+    diff.mismatchedFrames += mismatched ? 1 : 0;
+}
+
+double GetPercentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = std::min(values.size() - 1, (size_t)(percentile * values.size()));
+    return values[index];
+}
+
+bool OpenReference(MappedFile& file, const std::string& path, uint32_t boneCount, const ReplayOutputHeader*& header)
+{
+    if (!file.Open(path))
+    {
+        std::fprintf(stderr, "cannot open %s\n", path.c_str());
+        return false;
+    }
+    header = reinterpret_cast<const ReplayOutputHeader*>(file.GetData());
+    if (file.GetSize() < sizeof(ReplayOutputHeader) || std::memcmp(header->magic, ReplayOutputMagic, sizeof(ReplayOutputMagic))
+        || header->boneCount != boneCount || sizeof(ReplayOutputHeader) + header->frameCount * boneCount * 4 * sizeof(float) > file.GetSize())
+    {
+        std::fprintf(stderr, "%s is not the reference of this capture\n", path.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ParseParameters(int argc, char** argv, ReplayParameters& parameters)
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (!std::strcmp(argv[i], "--iterations") && i + 1 < argc)
+        {
+            parameters.iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--cold"))
+        {
+            parameters.warmStart = 0;
+        }
+        else if (!std::strcmp(argv[i], "--warm"))
+        {
+            parameters.warmStart = 1;
+        }
+        else if (!std::strcmp(argv[i], "--output") && i + 1 < argc)
+        {
+            parameters.outputPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--reference") && i + 1 < argc)
+        {
+            parameters.referencePath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--tolerance-mode") && i + 1 < argc)
+        {
+            parameters.solveTolerance = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--tolerance") && i + 1 < argc)
+        {
+            parameters.tolerance = std::max(0.0, std::atof(argv[++i]));
+        }
+        else if (argv[i][0] != '-' && parameters.capturePath.empty())
+        {
+            parameters.capturePath = argv[i];
+        }
+        else
+        {
+            parameters.capturePath.clear();
+            break;
+        }
+    }
+
+    if (parameters.capturePath.empty())
+    {
+        std::fprintf(stderr, "usage: light_ik_replay capture.likc [--iterations N] [--cold | --warm] [--tolerance-mode distance] [--output replay.likr] [--reference replay.likr] [--tolerance radians]\n");
+        return false;
+    }
+    return true;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    ReplayParameters parameters;
+    if (!ParseParameters(argc, argv, parameters))
+    {
+        return 1;
+    }
+
+    CaptureReader capture;
+    std::string error;
+    if (!capture.Open(parameters.capturePath, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    const FileHeader& header = capture.GetHeader();
+
+    MappedFile referenceFile;
+    const ReplayOutputHeader* reference = nullptr;
+    if (!parameters.referencePath.empty() && !OpenReference(referenceFile, parameters.referencePath, header.boneCount, reference))
+    {
+        return 1;
+    }
+
+    FILE* output = nullptr;
+    if (!parameters.outputPath.empty())
+    {
+        output = std::fopen(parameters.outputPath.c_str(), "wb");
+        if (!output)
+        {
+            std::fprintf(stderr, "cannot open %s\n", parameters.outputPath.c_str());
+            return 1;
+        }
+        ReplayOutputHeader outputHeader;
+        std::memcpy(outputHeader.magic, ReplayOutputMagic, sizeof(ReplayOutputMagic));
+        outputHeader.boneCount  = header.boneCount;
+        outputHeader.frameCount = capture.GetFramesCount();
+        std::fwrite(&outputHeader, sizeof(outputHeader), 1, output);
+    }
+
+    std::vector<ReplayGroup> groups = BuildGroups(capture);
+    std::vector<int32_t> boneConstraints = GetBoneConstraints(capture);
+    ReplayStats stats;
+    std::vector<double> frameTimes;
+    std::vector<float> rotations(header.boneCount * 4);
+    frameTimes.reserve(capture.GetFramesCount());
+    DiffResult diff;
+    for (uint64_t frame = 0; frame < capture.GetFramesCount(); ++frame)
+    {
+        frameTimes.emplace_back(ReplayFrame(groups, capture, boneConstraints, capture.GetFrame(frame), parameters, stats, rotations.data()));
+
+        if (reference && frame < reference->frameCount)
+        {
+            const float* referenceRotations = reinterpret_cast<const float*>(reference + 1) + frame * header.boneCount * 4;
+            CompareFrame(rotations.data(), referenceRotations, header.boneCount, frame, parameters.tolerance, diff);
+        }
+        if (output)
+        {
+            std::fwrite(rotations.data(), sizeof(float), rotations.size(), output);
+        }
+    }
+    if (output)
+    {
+        std::fclose(output);
+    }
+
+    double totalTime = 0;
+    for (double time : frameTimes)
+    {
+        totalTime += time;
+    }
+    // overrides of the captured solver settings, null if the settings of every frame are used
+    char iterations[32] = "null";
+    char tolerance[32]  = "null";
+    if (parameters.iterations > 0)
+    {
+        std::snprintf(iterations, sizeof(iterations), "%zu", parameters.iterations);
+    }
+    if (parameters.solveTolerance >= 0)
+    {
+        std::snprintf(tolerance, sizeof(tolerance), "%g", parameters.solveTolerance);
+    }
+    std::printf("{\n  \"capture\": \"%s\", \"solver_real_bytes\": %zu, \"bones\": %u, \"chains\": %u, \"groups\": %zu, "
+        "\"frames\": %llu, \"iterations\": %s, \"warm_start\": %s, \"tolerance_mode\": %s,\n",
+        parameters.capturePath.c_str(), sizeof(LightIK::real), header.boneCount, header.chainCount, groups.size(),
+        (unsigned long long)capture.GetFramesCount(), iterations, 
+        parameters.warmStart < 0 ? "null" : (parameters.warmStart ? "true" : "false"), tolerance);
+    std::printf("  \"solved_groups\": %llu, \"reseeded_groups\": %llu, \"iterations_per_solve\": %.2f,\n",
+        (unsigned long long)stats.solvedGroups, (unsigned long long)stats.reseededGroups,
+        stats.solvedGroups > 0 ? (double)stats.iterations / stats.solvedGroups : 0.0);
+    std::printf("  \"ns_per_frame\": %.1f, \"ns_per_frame_p50\": %.1f, \"ns_per_frame_p99\": %.1f, \"ns_per_frame_max\": %.1f",
+        frameTimes.empty() ? 0.0 : totalTime / frameTimes.size(), GetPercentile(frameTimes, 0.5), GetPercentile(frameTimes, 0.99),
+        frameTimes.empty() ? 0.0 : *std::max_element(frameTimes.begin(), frameTimes.end()));
+    if (reference)
+    {
+        std::printf(",\n  \"reference\": {\"compared_frames\": %llu, \"mismatched_frames\": %llu, \"first_mismatch_frame\": %lld, "
+            "\"first_mismatch_bone\": %d, \"max_angle_error\": %g, \"tolerance\": %g}",
+            (unsigned long long)diff.comparedFrames, (unsigned long long)diff.mismatchedFrames, (long long)diff.firstMismatchFrame,
+            diff.firstMismatchBone, diff.maxAngleError, parameters.tolerance);
+    }
+    std::printf("\n}\n");
+
+    // mismatch with the reference fails the run, so the replay can be used as the regression test
+    return diff.mismatchedFrames > 0 ? 2 : 0;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace LightIKReplay
+{
+
+/// @brief Read only memory mapping of the whole file. Captures are accessed in place, so long sessions
+/// are not loaded to memory before the replay
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path);
+    void Close();
+
+    const uint8_t* GetData() const      { return m_data;    }
+    size_t GetSize() const              { return m_size;    }
+
+private:
+#ifdef _WIN32
+    void*           m_file      = nullptr;
+    void*           m_mapping   = nullptr;
+#endif
+    const uint8_t*  m_data      = nullptr;
+    size_t          m_size      = 0;
+};
+
+}